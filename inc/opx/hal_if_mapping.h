@@ -210,6 +210,113 @@ void dn_hal_dump_interface_mapping(void);
  */
 t_std_error dn_hal_get_next_ifindex(hal_ifindex_t *ifindex, hal_ifindex_t *next_ifindex);
 
+/*!
+ *  Get the next interface of a given type within a VRF, in ifindex order.
+ *  Returns the full interface record so walks over a single interface type
+ *  (all LAGs, all VLANs ...) do not need a second lookup per step.
+ *  \param[in] if_type interface type to walk
+ *  \param[in] vrf_id VRF of the interfaces to walk
+ *  \param[in] ifindex pointer to the current interface index; in case of null pointer input,
+ *              gets the interface with the lowest ifindex of that type in the VRF
+ *  \param[out] p_intf_ctrl All fields populated with the next interface information
+ *  \return     std error code
+ */
+t_std_error dn_hal_get_next_intf_by_type(nas_int_type_t if_type, hal_vrf_id_t vrf_id,
+                                         const hal_ifindex_t *ifindex,
+                                         interface_ctrl_t *p_intf_ctrl);
+
+/*!
+ *  Callback used to walk interface records.
+ *  The record is only valid for the duration of the call and must not be
+ *  modified, and the callback must not call back into the interface DB.
+ *  \param[in] p_intf_ctrl interface record
+ *  \param[in] context caller context passed to the walk
+ *  \return     true to continue the walk, false to stop
+ */
+typedef bool (*dn_hal_intf_walk_fn)(const interface_ctrl_t *p_intf_ctrl, void *context);
+
+/*!
+ *  Get the number of interfaces mapped to ports of a given NPU
+ *  \param[in] npu_id NPU id
+ *  \return     number of mapped ports on the NPU
+ */
+size_t dn_hal_get_npu_port_count(npu_id_t npu_id);
+
+/*!
+ *  Get the next interface mapped to a port of a given NPU, in port-id order
+ *  \param[in] npu_id NPU id
+ *  \param[in] port_id pointer to the current port id; in case of null pointer input,
+ *              gets the interface mapped to the lowest port id of the NPU
+ *  \param[out] p_intf_ctrl All fields populated with the next interface information
+ *  \return     std error code
+ */
+t_std_error dn_hal_get_next_npu_port_intf(npu_id_t npu_id, const npu_port_t *port_id,
+                                          interface_ctrl_t *p_intf_ctrl);
+
+/*!
+ *  Walk all interfaces mapped to ports of a given NPU in port-id order.
+ *  The walk is done under a single read lock of the interface DB.
+ *  \param[in] npu_id NPU id
+ *  \param[in] fn callback invoked for every mapped port interface
+ *  \param[in] context caller context passed to the callback
+ *  \return     number of interfaces visited
+ */
+size_t dn_hal_walk_npu_ports(npu_id_t npu_id, dn_hal_intf_walk_fn fn, void *context);
+
+/*!
+ *  Type of change recorded in the interface DB change journal
+ */
+typedef enum {
+    HAL_INTF_CHANGE_REG = 1,     /* interface registered */
+    HAL_INTF_CHANGE_DEREG,       /* interface deregistered */
+    HAL_INTF_CHANGE_MAC,         /* MAC address updated */
+    HAL_INTF_CHANGE_DESC,        /* description updated */
+    HAL_INTF_CHANGE_L3_INFO,     /* router interface info updated */
+} hal_intf_change_type_t;
+
+/*!
+ *  Interface DB change journal entry.
+ *  Identifies the interface that changed; the current record can be read
+ *  with dn_hal_get_interface_info using HAL_INTF_INFO_FROM_IF.
+ */
+typedef struct {
+    uint64_t seq;                   //! sequence number of the change
+    hal_intf_change_type_t change;  //! type of change
+    nas_int_type_t int_type;        //! interface type
+    hal_vrf_id_t vrf_id;            //! VRF id of the interface
+    hal_ifindex_t if_index;         //! interface index under the VRF
+} hal_intf_change_t;
+
+/*!
+ *  Get the sequence number of the latest change to the interface DB
+ *  \return     latest change sequence number, 0 if nothing has changed yet
+ */
+uint64_t dn_hal_get_change_seq(void);
+
+/*!
+ *  Get the interface DB changes made after a given sequence number, oldest first.
+ *  The journal holds a bounded number of the latest changes. If the changes
+ *  following seq are no longer in the journal the caller must resynchronize
+ *  with dn_hal_walk_interfaces and continue from the sequence number it returns.
+ *  \param[in] seq last sequence number already processed by the caller
+ *  \param[out] changes buffer filled with the changes
+ *  \param[in,out] count in: number of entries in changes, out: number of entries filled
+ *  \param[out] last_seq sequence number of the latest change in the DB
+ *  \return     STD_ERR_OK, or STD_ERR(INTERFACE,FAIL,0) if the journal has wrapped past seq
+ */
+t_std_error dn_hal_get_changes_since(uint64_t seq, hal_intf_change_t *changes,
+                                     size_t *count, uint64_t *last_seq);
+
+/*!
+ *  Walk all interface records as one consistent snapshot.
+ *  The walk is done under a single read lock of the interface DB.
+ *  \param[in] fn callback invoked for every interface
+ *  \param[in] context caller context passed to the callback
+ *  \param[out] seq if not null, change sequence number the snapshot corresponds to
+ *  \return     number of interfaces visited
+ */
+size_t dn_hal_walk_interfaces(dn_hal_intf_walk_fn fn, void *context, uint64_t *seq);
+
 /**
  * @}
  */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: hal_if_shm.h
+ **/
+
+/**
+ * \file hal_if_shm.h
+ * \brief Read-only shared memory view of the interface DB.
+ *
+ * The process owning the interface DB publishes it into a POSIX shared
+ * memory segment. Other processes attach to the segment read-only and
+ * perform the same lookups as dn_hal_get_interface_info without keeping
+ * their own copy of the interface DB.
+ **/
+
+#ifndef __HAL_IF_SHM_H_
+#define __HAL_IF_SHM_H_
+
+#include "std_error_codes.h"
+#include "ds_common_types.h"
+#include "hal_if_mapping.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup NDIBaseIntfShm NDI Common - Shared memory interface DB
+ *
+ * @{
+ */
+
+#define HAL_IF_SHM_DEFAULT_NAME "/opx_nas_if_db"
+
+/**
+ * Handle to a shared memory interface DB segment
+ */
+typedef struct hal_if_shm_s *hal_if_shm_handle_t;
+
+/*!
+ *  Create (or re-create) the shared memory segment. Owner process only.
+ *  \param[in] name POSIX shared memory object name, eg HAL_IF_SHM_DEFAULT_NAME
+ *  \param[in] max_intfs maximum number of interfaces the segment can hold
+ *  \param[out] h handle to the segment
+ *  \return     std_error
+ */
+t_std_error dn_hal_shm_create(const char *name, size_t max_intfs, hal_if_shm_handle_t *h);
+
+/*!
+ *  Publish the current interface DB into the segment. Owner process only.
+ *  Readers keep using the previously published copy while this runs.
+ *  Nothing is written if the interface DB has not changed since the last publish.
+ *  \param[in] h handle returned by dn_hal_shm_create
+ *  \return     std_error
+ */
+t_std_error dn_hal_shm_publish(hal_if_shm_handle_t h);
+
+/*!
+ *  Attach read-only to a segment published by the owner process
+ *  \param[in] name POSIX shared memory object name
+ *  \param[out] h handle to the segment
+ *  \return     std_error
+ */
+t_std_error dn_hal_shm_attach(const char *name, hal_if_shm_handle_t *h);
+
+/*!
+ *  Function to get interface info from the shared memory interface DB.
+ *  Same query semantics as dn_hal_get_interface_info. The description is not
+ *  returned in p_intf_ctrl->desc (always NULL), use dn_hal_shm_get_intf_desc.
+ *  \param[in] h segment handle
+ *  \param[in,out] p_intf_ctrl query fields in, all fields populated on success
+ *  \return     std_error
+ */
+t_std_error dn_hal_shm_get_interface_info(hal_if_shm_handle_t h, interface_ctrl_t *p_intf_ctrl);
+
+/*!
+ *  Function to get the interface description from the shared memory interface DB
+ *  \param[in] h segment handle
+ *  \param[in] vrf_id VRF id of the interface
+ *  \param[in] if_index interface index under the VRF
+ *  \param[out] desc buffer filled with the description, empty string if none
+ *  \param[in] len size of the buffer
+ *  \return     std_error
+ */
+t_std_error dn_hal_shm_get_intf_desc(hal_if_shm_handle_t h, hal_vrf_id_t vrf_id,
+                                     hal_ifindex_t if_index, char *desc, size_t len);
+
+/*!
+ *  Get the interface DB change sequence number of the published copy
+ *  (see dn_hal_get_change_seq)
+ *  \param[in] h segment handle
+ *  \return     change sequence number, 0 if nothing has been published
+ */
+uint64_t dn_hal_shm_get_change_seq(hal_if_shm_handle_t h);
+
+/*!
+ *  Unmap the segment and free the handle.
+ *  The owner process also removes the shared memory object name.
+ *  \param[in] h segment handle
+ */
+void dn_hal_shm_close(hal_if_shm_handle_t h);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
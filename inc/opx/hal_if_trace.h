@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: hal_if_trace.h
+ **/
+
+/**
+ * \file hal_if_trace.h
+ * \brief Binary trace of interface DB calls.
+ *
+ * When the environment variable HAL_IF_TRACE_ENV_VAR names a file, every
+ * register, deregister, update and lookup call made to the interface DB
+ * is appended to that file. The trace can be replayed with nas_if_db_replay.
+ *
+ * File format - hal_if_trace_file_hdr_t followed by records. Each record is
+ * hal_if_trace_rec_t followed by name_len bytes of interface name and
+ * data_len bytes of operation data (MAC or description string).
+ **/
+
+#ifndef __HAL_IF_TRACE_H_
+#define __HAL_IF_TRACE_H_
+
+#include "std_error_codes.h"
+#include "ds_common_types.h"
+#include "hal_if_mapping.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup NDIBaseIntfTrace NDI Common - Interface DB trace
+ *
+ * @{
+ */
+
+#define HAL_IF_TRACE_ENV_VAR   "NAS_IF_DB_TRACE"
+#define HAL_IF_TRACE_MAGIC     0x5446494e  /* "NIFT" */
+#define HAL_IF_TRACE_VERSION   1
+
+typedef enum {
+    HAL_IF_TRACE_OP_REG = 1,            /* dn_hal_if_register HAL_INTF_OP_REG */
+    HAL_IF_TRACE_OP_DEREG,              /* dn_hal_if_register HAL_INTF_OP_DEREG */
+    HAL_IF_TRACE_OP_GET,                /* dn_hal_get_interface_info */
+    HAL_IF_TRACE_OP_GET_NEXT_IFINDEX,   /* dn_hal_get_next_ifindex */
+    HAL_IF_TRACE_OP_UPD_MAC,            /* dn_hal_update_intf_mac */
+    HAL_IF_TRACE_OP_UPD_DESC,           /* dn_hal_update_intf_desc */
+    HAL_IF_TRACE_OP_UPD_L3_INFO,        /* nas_cmn_update_router_intf_info */
+    HAL_IF_TRACE_OP_MAX
+} hal_if_trace_op_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+} hal_if_trace_file_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t ts_ns;         //! time of the call since start of the trace
+    uint8_t  op;            //! hal_if_trace_op_t
+    uint8_t  q_type;        //! intf_info_t of the call
+    uint16_t int_type;      //! nas_int_type_t
+    uint32_t int_sub_type;
+    uint32_t vrf_id;
+    int32_t  if_index;
+    int32_t  npu_id;
+    int32_t  tap_id;
+    int32_t  sub_interface;
+    uint8_t  ids[8];        //! raw port/vlan/lag/bridge id union of interface_ctrl_t
+    uint32_t l3_vrf_id;
+    int32_t  l3_if_index;
+    uint8_t  name_len;
+    uint16_t data_len;
+} hal_if_trace_rec_t;
+
+/*!
+ *  Start tracing interface DB calls to a file. Called automatically on first
+ *  use of the interface DB when HAL_IF_TRACE_ENV_VAR is set.
+ *  \param[in] path trace file, truncated if it exists
+ *  \return     std_error
+ */
+t_std_error dn_hal_trace_start(const char *path);
+
+/*!
+ *  Stop tracing and flush the trace file
+ */
+void dn_hal_trace_stop(void);
+
+/*!
+ *  Append a call to the trace. Used by the interface DB on every traced call
+ *  when dn_hal_trace_enabled, returns immediately when tracing is off.
+ *  \param[in] op traced operation
+ *  \param[in] p interface control block passed to the call
+ *  \param[in] data MAC or description string of the call, or NULL
+ */
+void dn_hal_trace_record(hal_if_trace_op_t op, const interface_ctrl_t *p, const char *data);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+
+#include <atomic>
+
+extern std::atomic<bool> hal_if_trace_on;
+
+/*!
+ *  Cheap check done by the interface DB before building a trace record
+ *  \return     true if interface DB calls are being traced
+ */
+static inline bool dn_hal_trace_enabled() {
+    return hal_if_trace_on.load(std::memory_order_relaxed);
+}
+#endif
+
+#endif
@@ -27,6 +27,9 @@
 
 #include "nas_base_obj.h"
 #include <string> 
+#include <vector>
+#include <future>
+#include <stdint.h>
 
 namespace nas {
 
@@ -37,6 +40,123 @@ void base_delete_obj_ndi (base_obj_t& t_del, bool rolling_back);
 void base_modify_obj_ndi (base_obj_t& t_new, base_obj_t& t_old, 
                           bool rolling_back);
 
+/*!
+ * \class base_txn_t
+ * \brief Commit of many objects to NDI as a single transaction.
+ *
+ * Objects are added with add_create/add_modify/add_delete. These run the
+ * object's own commit_create/commit_modify/commit_delete, so object
+ * specific validation still happens there, but the NDI push is queued
+ * instead of done. Object bookkeeping (dirty flags, set attributes,
+ * NPU list) is updated at that point and saved from before the add.
+ *
+ * commit() then pushes the queued changes one NPU at a time, in the order
+ * they were added for each NPU, keeping one rollback journal for the whole
+ * transaction. The NDI object of a create is filled at its first push, so
+ * it sees the NDI ids of objects created earlier in the transaction.
+ * A failure rolls back every change pushed so far in reverse order,
+ * restores the saved bookkeeping of every added object and rethrows.
+ * Other objects queued by an object's commit, eg dependent objects, are
+ * rolled back in NDI but their bookkeeping is left as is.
+ * An add whose commit throws leaves nothing queued.
+ * Queued changes are dropped after commit() either way.
+ *
+ * An object created in the transaction is only in NDI after commit(), so
+ * adding a modify or delete of it to the same transaction is rejected.
+ *
+ * Objects must stay alive until commit() returns.
+ * This class is NOT thread-safe. It is left to the users of this class.
+ */
+class base_txn_t
+{
+    public:
+        base_txn_t () {}
+        base_txn_t (const base_txn_t&) = delete;
+        base_txn_t& operator= (const base_txn_t&) = delete;
+
+        void        add_create (base_obj_t& obj_new);
+        attr_set_t  add_modify (base_obj_t& obj_new, base_obj_t& obj_old);
+        void        add_delete (base_obj_t& obj_old);
+
+        /*! Push all queued changes to NDI
+         *  Throws the first NDI failure after rolling back the transaction */
+        void        commit ();
+
+        /*! Number of queued object changes */
+        size_t      size () const {return _ops.size ();}
+
+        /// Used by base_*_obj_ndi to queue the push of the object being added
+        static base_txn_t* current ();
+        void        queue_create (base_obj_t& obj_new);
+        void        queue_modify (base_obj_t& obj_new, base_obj_t& obj_old);
+        void        queue_delete (base_obj_t& obj_old);
+
+    private:
+        enum txn_op_type_t {TXN_CREATE, TXN_MODIFY, TXN_DELETE};
+
+        struct txn_op_t {
+            txn_op_type_t   type;
+            base_obj_t*     obj_new;    // NULL for delete
+            base_obj_t*     obj_old;    // NULL for create
+            attr_set_t      dirty_attrs;
+            npu_set_t       npus_added;
+            npu_set_t       npus_deleted;
+            npu_set_t       npus_unchanged;
+            void*           ndi_obj = nullptr;     // filled from obj_new at first push
+            void*           old_ndi_obj = nullptr; // filled from obj_old for rollback
+            bool            ndi_obj_filled = false;
+            base_obj_t::commit_state_t  saved {};  // bookkeeping before the add
+            bool            has_saved = false;     // op of the object passed to add_*
+        };
+
+        struct journal_elem_t {
+            size_t          op;
+            rollbk_elem_t   elem;
+        };
+
+        template <typename F>
+        void _add (base_obj_t& obj, F commit);
+        void _check_not_created (const base_obj_t& obj_old, const char* fn) const;
+        void _push_npu (size_t op_idx, npu_id_t npu_id, mem_alloc_helper_t& mem_trakr);
+        void _rollback (mem_alloc_helper_t& mem_trakr);
+
+        std::vector<txn_op_t>       _ops;
+        std::vector<journal_elem_t> _journal;
+};
+
+/*! Set the number of worker threads used to push objects to NPUs in
+ *  parallel. Only objects that return true from push_npus_in_parallel
+ *  are pushed in parallel. With 0 workers (default) all objects are
+ *  pushed to one NPU after another. Not to be called while commits are
+ *  in progress. */
+void base_ndi_set_npu_workers (size_t workers);
+
+/*! Asynchronous commit of an object to NDI.
+ *  The commit_create/commit_modify/commit_delete of the object is queued on
+ *  the NDI commit executor and the returned future carries its result or
+ *  the base_exception it threw. The object must not be used by the caller
+ *  until the future is ready.
+ *
+ *  Commits with the same order_key run one after another in the order they
+ *  were queued, commits with different keys may run concurrently. Give
+ *  dependent objects the same key. order_key 0 uses the object itself as
+ *  the key, ordering only the commits of that object. For a modify that
+ *  is obj_old, the object obj_new was copied from.
+ *
+ *  With no executor workers (default) the commit runs in the calling
+ *  thread before returning. */
+std::future<void>       base_commit_create_async (base_obj_t& obj_new, bool rolling_back,
+                                                  uint64_t order_key = 0);
+std::future<attr_set_t> base_commit_modify_async (base_obj_t& obj_new, base_obj_t& obj_old,
+                                                  bool rolling_back, uint64_t order_key = 0);
+std::future<void>       base_commit_delete_async (base_obj_t& obj_old, bool rolling_back,
+                                                  uint64_t order_key = 0);
+
+/*! Set the number of NDI commit executor threads used by the
+ *  base_commit_*_async functions. Queued commits are completed before the
+ *  current workers exit. Not to be called while commits are being queued. */
+void base_ndi_set_commit_workers (size_t workers);
+
 }
 
 #endif
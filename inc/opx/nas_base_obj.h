@@ -92,6 +92,13 @@ class base_obj_t
     public:
         ////// Constructor/Destructor /////
         base_obj_t (base_switch_t* switch_p) : _switch_p (switch_p) {};
+        // base_attr_id is the lowest attribute ID of the object class.
+        // Attribute tracking then keeps the class attributes in the inline
+        // window of attr_set_t instead of anchoring it at the first
+        // attribute marked dirty.
+        base_obj_t (base_switch_t* switch_p, nas_attr_id_t base_attr_id)
+            : _dirty_attributes (base_attr_id), _set_attributes (base_attr_id),
+              _switch_p (switch_p) {};
         virtual ~base_obj_t () = 0;
 
         ///////////    Accessors    ///////////
@@ -111,6 +118,10 @@ class base_obj_t
         // Track change in NPU list in a given transaction
         bool                  is_npu_list_dirty () const;
 
+        // Number of leaf attribute pushes to NPUs skipped so far by
+        // commit_modify because the value did not change (see attr_equal)
+        static uint64_t       skipped_attr_pushes ();
+
         ///////////          Virtual getters        ////////////
         //    Can be overridden for more specific behavior   //
 
@@ -132,6 +143,20 @@ class base_obj_t
         void      mark_ndi_created () {_ndi_created = true;}
         void      mark_ndi_removed () {_ndi_created = false;}
 
+        /// Object bookkeeping updated by commit_create/modify/delete.
+        /// Saved before a commit whose NDI push may still be undone later
+        /// (see base_txn_t) and restored when it is.
+        struct commit_state_t {
+            attr_set_t  dirty_attributes;
+            attr_set_t  set_attributes;
+            npu_set_t   npus;
+            bool        npu_list_dirty;
+            bool        following_switch_npus;
+            bool        ndi_created;
+        };
+        commit_state_t  save_commit_state () const;
+        void            restore_commit_state (const commit_state_t& state);
+
         ///////     Virtual functions to change NPU set     ////////
         /*! Add NPU to the set of NPUs, object needs to be pushed to
          * Marks the NPU list dirty.
@@ -175,6 +200,40 @@ class base_obj_t
         // pushed to NDI anytime this object is created or deleted in NDI.
         virtual bool has_dependent_objs () {return false;}
 
+        /// Override to return TRUE if the push_*_to_npu routines of this
+        /// object can run concurrently for different NPUs. Commit then
+        /// pushes to the NPUs in parallel on the NPU worker pool
+        /// (see base_ndi_set_npu_workers).
+        /// Any object state the push routines write, eg NDI object ids
+        /// kept in an ndi_obj_id_table_t whose insert moves the other
+        /// entries, must then be synchronized or sized before the push.
+        /// Override push_create_obj_to_npu_parallel to store the ids of
+        /// created NDI objects after the push instead.
+        virtual bool push_npus_in_parallel () const {return false;}
+
+        /// Push newly created object to NDI for given NPU from the NPU
+        /// worker pool. Runs concurrently for different NPUs, so return the
+        /// NDI object id in ndi_obj_id rather than storing it in the object:
+        /// set_pushed_ndi_obj_id is called with it for each NPU pushed once
+        /// all NPUs are done. Default calls push_create_obj_to_npu.
+        virtual bool push_create_obj_to_npu_parallel (npu_id_t npu_id,
+                                                      void* ndi_obj,
+                                                      ndi_obj_id_t& ndi_obj_id)
+        {return push_create_obj_to_npu (npu_id, ndi_obj);}
+
+        /// Store the NDI object id returned by push_create_obj_to_npu_parallel
+        /// for given NPU. Called from the committing thread.
+        virtual void set_pushed_ndi_obj_id (npu_id_t npu_id,
+                                            ndi_obj_id_t ndi_obj_id) {}
+
+        /// Override to return TRUE if attribute has the same value in
+        /// this object and in obj_old. commit_modify then removes it from
+        /// the dirty attributes so it is not pushed to NDI again.
+        /// Useful when CPS requests re-send unchanged attribute values.
+        /// Default never compares values and pushes every dirty attribute.
+        virtual bool attr_equal (nas_attr_id_t attr_id,
+                                 const base_obj_t& obj_old) const {return false;}
+
         /// Push newly created object to NDI for given NPU.
         /// Will also be called for Rollback of previous Delete object.
         /// NDI object create API should be called here.
@@ -207,6 +266,27 @@ class base_obj_t
         virtual bool push_leaf_attr_to_npu (nas_attr_id_t attr_id,
                                             npu_id_t npu_id) = 0;
 
+        /// Push change in value for a run of consecutive dirty leaf
+        /// attributes to NDI for given NPU. Non-leaf attributes in between
+        /// end the run, so the dirty attribute order is kept.
+        /// Override to program them with a single bulk NDI call.
+        /// Default calls push_leaf_attr_to_npu for each attribute.
+        /// If True returned then the batch is tracked for rollback, see
+        /// rollback_leaf_attrs_in_npu.
+        /// A batch that throws is also rolled back as it may be partially
+        /// programmed.
+        virtual bool push_leaf_attrs_to_npu (const attr_list_t& attr_list,
+                                             npu_id_t npu_id);
+
+        /// Restore old values of a batch pushed by push_leaf_attrs_to_npu,
+        /// called on the old object. Default calls push_leaf_attr_to_npu
+        /// for each attribute and logs a failure without stopping, so one
+        /// failed attribute does not leave the others at their new values.
+        /// Override together with push_leaf_attrs_to_npu to restore the
+        /// batch with a single bulk NDI call.
+        virtual void rollback_leaf_attrs_in_npu (const attr_list_t& attr_list,
+                                                 npu_id_t npu_id);
+
         // The following routines SHOULD be overridden
         // if there are non-leaf read-write attributes in the object
         // which can be modified after initial creation
@@ -303,6 +383,22 @@ inline void base_obj_t::mark_attr_dirty (nas_attr_id_t attr_id)
     _dirty_attributes.add (attr_id);
 }
 
+inline base_obj_t::commit_state_t base_obj_t::save_commit_state () const
+{
+    return {_dirty_attributes, _set_attributes, _npus, _npu_list_dirty,
+            _following_switch_npus, _ndi_created};
+}
+
+inline void base_obj_t::restore_commit_state (const commit_state_t& state)
+{
+    _dirty_attributes = state.dirty_attributes;
+    _set_attributes = state.set_attributes;
+    _npus = state.npus;
+    _npu_list_dirty = state.npu_list_dirty;
+    _following_switch_npus = state.following_switch_npus;
+    _ndi_created = state.ndi_created;
+}
+
 inline nas_switch_id_t base_obj_t::switch_id() const
 {
     return _switch_p->id();
@@ -29,10 +29,18 @@
 #include "std_bit_masks.h"
 #include "ds_common_types.h"
 #include "nas_types.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cstddef>
+#include <new>
+#include <atomic>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <unordered_map>
 
 namespace nas {
@@ -41,29 +49,77 @@ namespace nas {
  * \class npu_set_t
  * \brief Collection of unique set of NPUs
  *
+ *  NPU IDs below INLINE_BITS are kept in an inline bitmask so that copy,
+ *  contains and compare are a few word operations without heap allocation.
+ *  Other NPU IDs go to an overflow set. Iteration is in ascending NPU order.
+ *
  * This class is NOT thread-safe. It is left to the users of this class.
  */
 class npu_set_t
 {
     public:
+        static constexpr size_t INLINE_WORDS = 2;
+        static constexpr size_t INLINE_BITS = INLINE_WORDS * 64;
+
         typedef std::set<npu_id_t> npu_internal_set_t;
-        typedef npu_internal_set_t::iterator npu_iter_t;
-        typedef npu_internal_set_t::const_iterator const_npu_iter_t;
 
-        void add (npu_id_t npu_id) { _npus.insert (npu_id); }
-        void clear () { _npus.clear (); }
-        void del (npu_id_t npu_id) {_npus.erase (npu_id);}
+        class const_iterator
+        {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef npu_id_t value_type;
+                typedef ptrdiff_t difference_type;
+                typedef const npu_id_t* pointer;
+                typedef npu_id_t reference;
+
+                npu_id_t operator* () const {
+                    return (_bit < INLINE_BITS) ? (npu_id_t)_bit : *_sit;
+                }
+                const_iterator& operator++ ();
+                const_iterator operator++ (int) {auto tmp = *this; ++(*this); return tmp;}
+                bool operator== (const const_iterator& rhs) const {
+                    return _bit == rhs._bit && _sit == rhs._sit;
+                }
+                bool operator!= (const const_iterator& rhs) const {return !(*this == rhs);}
+
+            private:
+                friend class npu_set_t;
+                const_iterator (const npu_set_t* set, size_t bit,
+                                npu_internal_set_t::const_iterator sit)
+                    : _set (set), _bit (bit), _sit (sit) {}
+
+                const npu_set_t*                    _set;
+                size_t                              _bit; // INLINE_BITS when in the overflow set
+                npu_internal_set_t::const_iterator  _sit;
+        };
+        typedef const_iterator npu_iter_t;
+        typedef const_iterator const_npu_iter_t;
+
+        void add (npu_id_t npu_id) {
+            if (_inline (npu_id)) _mask[npu_id / 64] |= (1ULL << (npu_id % 64));
+            else _overflow.insert (npu_id);
+        }
+        void clear () {
+            for (auto& word: _mask) word = 0;
+            _overflow.clear ();
+        }
+        void del (npu_id_t npu_id) {
+            if (_inline (npu_id)) _mask[npu_id / 64] &= ~(1ULL << (npu_id % 64));
+            else _overflow.erase (npu_id);
+        }
 
-        bool empty () const {return _npus.empty();}
-        size_t size () const {return _npus.size();}
-        npu_iter_t begin () {return _npus.begin();}
-        npu_iter_t end () {return _npus.end();}
-        const_npu_iter_t begin () const {return _npus.begin();}
-        const_npu_iter_t end () const {return _npus.end();}
+        bool empty () const;
+        size_t size () const;
+        const_iterator begin () const;
+        const_iterator end () const {return const_iterator (this, INLINE_BITS, _overflow.end());}
 
         bool contains (npu_id_t npu) const {
-            return (_npus.find (npu) != end());
+            if (_inline (npu)) return (_mask[npu / 64] >> (npu % 64)) & 1;
+            return !_overflow.empty() && (_overflow.find (npu) != _overflow.end());
         }
+        bool operator== (const npu_set_t& rhs) const;
+        bool operator!= (const npu_set_t& rhs) const {return !(*this == rhs);}
+
         // Copy NPU list as a string to str
         void dump (std::string& str) const;
 
@@ -74,9 +130,25 @@ class npu_set_t
                       npu_set_t& only_second,
                       npu_set_t& in_both) const;
     private:
-        npu_internal_set_t _npus;
+        static bool _inline (npu_id_t npu_id) {
+            return npu_id >= 0 && (size_t)npu_id < INLINE_BITS;
+        }
+        /* Next set bit of the mask at or after bit, INLINE_BITS if none */
+        size_t _next_bit (size_t bit) const;
+
+        uint64_t           _mask[INLINE_WORDS] = {};
+        npu_internal_set_t _overflow;
 };
 
+/* Per allocation debug logs of mem_alloc_helper_t are compiled in only
+ * when NAS_MEM_ALLOC_HELPER_DEBUG is defined */
+#ifdef NAS_MEM_ALLOC_HELPER_DEBUG
+#define NAS_MEM_ALLOC_HELPER_LOG(...) \
+    EV_LOGGING (NAS_COM, DEBUG, "MEM-ALLOC-HELPER", __VA_ARGS__)
+#else
+#define NAS_MEM_ALLOC_HELPER_LOG(...)
+#endif
+
 /*!
  * \class mem_alloc_helper_t
  * \brief Helper class to track and free heap memory allocation.
@@ -92,6 +164,10 @@ class npu_set_t
  * caller function that consumes this variable length data so that the
  * memory is freed after the caller function goes out of scope.
  *
+ * Memory is handed out from an arena - an inline first block of
+ * INLINE_BYTES followed by heap blocks that double in size. An allocation
+ * is a pointer bump, and all blocks are released together in the destructor.
+ *
  * No copy or move of helper objects is allowed since it owns pointers
  * This class is NOT thread-safe. It is left to the users of this class.
  *
@@ -101,15 +177,11 @@ class npu_set_t
 class mem_alloc_helper_t
 {
     public:
+        static constexpr size_t INLINE_BYTES = 4096;
+
         mem_alloc_helper_t () {};
-        ~mem_alloc_helper_t ()
-        {
-            for (auto ptr: ptr_list) {
-                EV_LOGGING (NAS_COM, DEBUG, "MEM-ALLOC-HELPER",
-                            "Free %p\r\n", ptr);
-                free (ptr);
-            }
-        }
+        ~mem_alloc_helper_t ();
+
         /* No copy or move constructor or assignment allowed
          * since objects of this class own pointers */
         mem_alloc_helper_t (const mem_alloc_helper_t&) = delete;
@@ -117,26 +189,44 @@ class mem_alloc_helper_t
         mem_alloc_helper_t (mem_alloc_helper_t&&) = delete;
         mem_alloc_helper_t& operator= (mem_alloc_helper_t&&) = delete;
 
-        /*! Allocate heap memory and track pointer for freeing */
+        /*! Allocate zeroed memory for count objects of T from the arena */
         template <typename T> T* alloc (size_t count)
         {
-            T* ptr = (T*) calloc (sizeof (T), count);
-            if (ptr == NULL) throw std::bad_alloc{};
-            EV_LOGGING (NAS_COM, DEBUG, "MEM-ALLOC-HELPER",
-                        "Alloc %p\r\n", ptr);
-            try {
-                ptr_list.push_back (ptr);
-            } catch (...) {
-                free (ptr);
-                throw;
-            }
+            if (count > SIZE_MAX / sizeof (T)) throw std::bad_alloc{};
+            T* ptr = static_cast<T*> (_bump (count * sizeof (T), alignof (T)));
+            NAS_MEM_ALLOC_HELPER_LOG ("Alloc %p\r\n", ptr);
             return ptr;
         }
 
         /*! Add previous externally allocated heap memory to tracker list
          *  for freeing */
         void add (void* ptr) {ptr_list.push_back (ptr);}
+
     private:
+        /* Header of the heap blocks, data follows */
+        struct alignas (std::max_align_t) block_t {
+            block_t* next;
+            size_t   size;
+        };
+
+        void* _bump (size_t bytes, size_t align)
+        {
+            uintptr_t pos = (_cur + align - 1) & ~(uintptr_t)(align - 1);
+            if (pos < _cur || pos > _end || bytes > _end - pos) {
+                _grow (bytes, align);
+                pos = (_cur + align - 1) & ~(uintptr_t)(align - 1);
+            }
+            _cur = pos + bytes;
+            memset ((void*) pos, 0, bytes);
+            return (void*) pos;
+        }
+        void _grow (size_t bytes, size_t align);
+
+        alignas (std::max_align_t) char _inline_block[INLINE_BYTES];
+        uintptr_t          _cur = (uintptr_t) _inline_block;
+        uintptr_t          _end = (uintptr_t) _inline_block + INLINE_BYTES;
+        size_t             _next_block_size = 2 * INLINE_BYTES;
+        block_t*           _blocks = nullptr;
         std::vector<void*> ptr_list;
 };
 
@@ -144,31 +234,79 @@ class mem_alloc_helper_t
  * \class attr_set_t
  * \brief Collection of unique set of attribute IDs
  *
+ *  Attribute IDs of an object class are dense, so IDs within WINDOW_BITS
+ *  of the base attribute ID are kept in an inline bitmap. The base is given
+ *  at construction or taken from the first attribute added. IDs outside the
+ *  window fall back to a sparse set. Iteration is in ascending ID order.
+ *
  *  This class is NOT thread-safe. It is left to the users of this class.
  */
 class attr_set_t
 {
     public:
+        static constexpr size_t WINDOW_WORDS = 4;
+        static constexpr size_t WINDOW_BITS = WINDOW_WORDS * 64;
+
         typedef std::set<nas_attr_id_t> attr_internal_set_t;
-        typedef attr_internal_set_t::iterator attr_set_iter_t ;
-        typedef attr_internal_set_t::const_iterator const_attr_set_iter_t;
+
+        class const_iterator
+        {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef nas_attr_id_t value_type;
+                typedef ptrdiff_t difference_type;
+                typedef const nas_attr_id_t* pointer;
+                typedef nas_attr_id_t reference;
+
+                nas_attr_id_t operator* () const {
+                    return (_bit < WINDOW_BITS) ? _set->_base + _bit : *_sit;
+                }
+                const_iterator& operator++ ();
+                const_iterator operator++ (int) {auto tmp = *this; ++(*this); return tmp;}
+                bool operator== (const const_iterator& rhs) const {
+                    return _bit == rhs._bit && _sit == rhs._sit;
+                }
+                bool operator!= (const const_iterator& rhs) const {return !(*this == rhs);}
+
+            private:
+                friend class attr_set_t;
+                const_iterator (const attr_set_t* set, size_t bit,
+                                attr_internal_set_t::const_iterator sit)
+                    : _set (set), _bit (bit), _sit (sit) {}
+
+                const attr_set_t*                    _set;
+                size_t                               _bit; // WINDOW_BITS when not in the window
+                attr_internal_set_t::const_iterator  _sit;
+        };
+        typedef const_iterator attr_set_iter_t;
+        typedef const_iterator const_attr_set_iter_t;
+
+        attr_set_t () {}
+        explicit attr_set_t (nas_attr_id_t base_attr_id)
+            : _base (base_attr_id), _base_valid (true) {}
 
         void add (nas_attr_id_t attr_id);
+        void del (nas_attr_id_t attr_id);
         void clear ();
 
-        size_t size () const {return _attributes.size();}
-        attr_set_iter_t begin () {return _attributes.begin();}
-        attr_set_iter_t end () {return _attributes.end();}
-        const_attr_set_iter_t begin () const {return _attributes.begin();}
-        const_attr_set_iter_t end () const {return _attributes.end();}
+        size_t size () const;
+        bool empty () const {return size() == 0;}
+        const_iterator begin () const;
+        const_iterator end () const {return const_iterator (this, WINDOW_BITS, _sparse.end());}
 
         bool contains (nas_attr_id_t attr_id) const {
-            return (_attributes.find (attr_id) != _attributes.end());
+            if (_in_window (attr_id)) {
+                size_t bit = attr_id - _base;
+                return (_window[bit / 64] >> (bit % 64)) & 1;
+            }
+            return !_sparse.empty() && (_sparse.find (attr_id) != _sparse.end());
         }
 
-        /*! Max Attribute ID in this attribute set. */
+        /*! Max Attribute ID in this attribute set, 0 if empty. */
         size_t len() const {return _max_attr_id;}
-        size_t count() const {return _attributes.size();}
+        /*! First attribute ID of the inline window */
+        nas_attr_id_t base_attr_id () const {return _base;}
+        size_t count() const {return size();}
 
         /*! Convert the attribute set to an array
          *  Caller has to pass in pre-allocated memory
@@ -192,8 +330,18 @@ class attr_set_t
         attr_set_t& operator+= (const attr_set_t& rhs);
 
     private:
+        bool _in_window (nas_attr_id_t attr_id) const {
+            return _base_valid && attr_id >= _base && attr_id - _base < WINDOW_BITS;
+        }
+        /* Next set bit of the window at or after bit, WINDOW_BITS if none */
+        size_t _next_bit (size_t bit) const;
+        void _recompute_max ();
+
         nas_attr_id_t               _max_attr_id = 0;
-        attr_internal_set_t         _attributes;
+        nas_attr_id_t               _base = 0;
+        bool                        _base_valid = false;
+        uint64_t                    _window[WINDOW_WORDS] = {};
+        attr_internal_set_t         _sparse;
 };
 
 /*!  Collection of non-unique list of attribute IDs */
@@ -219,6 +367,9 @@ enum rollbk_type_t {
     // For embedded attributes
     ROLLBK_CREATE_ATTR,
     ROLLBK_DELETE_ATTR,
+    // Leaf attributes pushed together with push_leaf_attrs_to_npu,
+    // attr_hierarchy holds the attributes of the batch
+    ROLLBK_MODIFY_ATTRS,
 };
 
 /*! Details of each change committed to NDI being tracked for rollback */
@@ -235,6 +386,11 @@ typedef std::vector<rollbk_elem_t> rollback_trakr_t;
 /*! \class id_generator_t
  *  \brief Generate free IDs for NAS objects
  *
+ *  IDs 1 to max_ids are tracked in a bitmap of free IDs with summary levels
+ *  above it - a bit at each level is set when the 64-bit word below it has
+ *  any free ID. Finding a free ID walks at most log64(max_ids) levels.
+ *  Allocation is next-fit starting after the last allocated ID.
+ *
  *  Objects of this type cannot be copied. However Move is allowed.
  *  This class is NOT thread-safe. It is left to the users of this class.
  */
@@ -242,14 +398,6 @@ class id_generator_t
 {
     public:
         id_generator_t (size_t max_ids);
-        ~id_generator_t () noexcept
-        {
-            std_bitmaparray_free_data (_id_bitmap);
-        }
-
-        // Override the default copy and move
-        // constructors/assignment operators
-        // since objects of this class own naked pointer
 
         // Copying is not allowed
         id_generator_t (const id_generator_t& copy) = delete;
@@ -263,6 +411,17 @@ class id_generator_t
          * \return unused ID identified */
         nas_obj_id_t   alloc_id ();
 
+        /*! Find count unused IDs and mark them as used.
+         *  Nothing is allocated if fewer than count IDs are free.
+         * \param[in] count - number of IDs to allocate
+         * \param[out] ids  - allocated IDs appended in allocation order */
+        void           alloc_ids (size_t count, std::vector<nas_obj_id_t>& ids);
+
+        /*! Find len contiguous unused IDs and mark them as used
+         * \param[in] len - number of IDs in the range
+         * \return first ID of the range */
+        nas_obj_id_t   alloc_range (size_t len);
+
         /*! Mark given ID as used.
          * \param[in] id - ID to be reserved
          * \return         False if already being used */
@@ -271,10 +430,118 @@ class id_generator_t
         /*! Release given ID to unused list */
         void           release_id (nas_obj_id_t id) noexcept;
 
+        /*! Number of unused IDs */
+        size_t         free_count () const noexcept {return _free;}
+
+        /*! Save the used/unused state of all IDs, eg for warm restart.
+         *  The blob is in host byte order and carries a checksum.
+         * \param[out] blob - replaced with the snapshot
+         * \param[in] rle   - run-length encode the bitmap, compact when
+         *                    used IDs are clustered */
+        void           snapshot (std::vector<uint8_t>& blob, bool rle = false) const;
+
+        /*! Restore the state saved by snapshot. The cost depends on the size
+         *  of the ID space only, not on the number of used IDs.
+         *  Throws NAS_BASE_E_PARAM, leaving the state unchanged, if the blob
+         *  is corrupt or was taken from an ID space of a different size.
+         * \param[in] blob - snapshot data
+         * \param[in] len  - snapshot length in bytes */
+        void           restore (const void* blob, size_t len);
+
     private:
-        const size_t _max_ids;
+        static constexpr size_t NPOS = (size_t) -1;
+
+        /* Header of the snapshot blob, payload follows */
+        struct __attribute__((packed)) snapshot_hdr_t {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t flags;
+            uint64_t max_ids;
+            uint64_t free;
+            uint64_t payload_len;
+            uint32_t checksum;  // FNV-1a of the payload
+        };
+        static constexpr uint32_t SNAPSHOT_MAGIC = 0x4e494447;  /* "NIDG" */
+        static constexpr uint16_t SNAPSHOT_VERSION = 1;
+        static constexpr uint16_t SNAPSHOT_F_RLE = 0x1;
+
+        /* Recompute the summary levels from the bitmap */
+        void   _rebuild_summary () noexcept;
+
+        /* First free ID at or after pos, NPOS if none */
+        size_t _find_free (size_t pos) const noexcept;
+        /* First used ID at or after pos and before limit, limit if none */
+        size_t _find_used (size_t pos, size_t limit) const noexcept;
+        /* Mark the IDs in mask of a bitmap word as used or free */
+        void   _mark_word (size_t word, uint64_t mask, bool free) noexcept;
+        /* Mark IDs [pos, pos+len) as used or free */
+        void   _mark (size_t pos, size_t len, bool free) noexcept;
+
+        size_t _max_ids;
         size_t _pos = 1;
-        void* _id_bitmap = NULL;
+        size_t _free = 0;
+        /* _levels[0] is the free ID bitmap, each next level summarizes
+         * the words of the level below, the last level is a single word */
+        std::vector<std::vector<uint64_t>> _levels;
+};
+
+/*! \class concurrent_id_generator_t
+ *  \brief Thread-safe generator of free IDs for NAS objects
+ *
+ *  Same ID space and alloc_id/reserve_id/release_id semantics as
+ *  id_generator_t, usable from multiple threads without a lock.
+ *  IDs are claimed and released with atomic fetch-and/fetch-or on 64-bit
+ *  words of the free ID bitmap, with a summary bitmap of words that have
+ *  free IDs. Each thread keeps its own allocation hint, spread over the ID
+ *  space, so concurrent allocators work on different bitmap words.
+ *
+ *  alloc_id throws NAS_BASE_E_FULL when it finds no free ID in one pass
+ *  over the ID space, IDs released concurrently with the pass may be missed.
+ *
+ *  Objects of this type cannot be copied or moved.
+ */
+class concurrent_id_generator_t
+{
+    public:
+        concurrent_id_generator_t (size_t max_ids);
+
+        concurrent_id_generator_t (const concurrent_id_generator_t&) = delete;
+        concurrent_id_generator_t& operator= (const concurrent_id_generator_t&) = delete;
+
+        /*! Find an unused ID and mark it as used
+         * \return unused ID identified */
+        nas_obj_id_t   alloc_id ();
+
+        /*! Mark given ID as used.
+         * \param[in] id - ID to be reserved
+         * \return         False if already being used */
+        bool           reserve_id (nas_obj_id_t id) noexcept;
+
+        /*! Release given ID to unused list */
+        void           release_id (nas_obj_id_t id) noexcept;
+
+        /*! Number of unused IDs, counted from the bitmap. Not a shared
+         *  counter so that allocating threads do not contend on it.
+         *  Exact only when no other thread is updating. */
+        size_t         free_count () const noexcept;
+
+    private:
+        static constexpr size_t HINT_SLOTS = 64;
+
+        struct alignas (64) hint_t {
+            std::atomic<size_t> word {0};
+        };
+
+        /* Clear the summary bit of a bitmap word that became empty */
+        void _word_emptied (size_t word) noexcept;
+        static size_t _hint_slot () noexcept;
+
+        const size_t                            _max_ids;
+        const size_t                            _words;
+        const size_t                            _summary_words;
+        std::unique_ptr<std::atomic<uint64_t>[]> _bitmap;
+        std::unique_ptr<std::atomic<uint64_t>[]> _summary;
+        hint_t                                  _hints[HINT_SLOTS];
 };
 
 } // End namespace nas
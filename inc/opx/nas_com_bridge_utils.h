@@ -24,6 +24,16 @@
 #include "std_error_codes.h"
 #include "ds_common_types.h"
 
+#include <string>
+#include <vector>
+
+/* Entry of the bulk untagged VLAN id operations */
+typedef struct {
+    const char *br_name;    /* 1D bridge name */
+    hal_vlan_id_t vlan_id;  /* untagged VLAN id - in for add, out for get */
+    t_std_error rc;         /* out - result for this entry */
+} nas_com_br_untag_vid_t;
+
 t_std_error nas_com_get_1d_br_untag_vid(const char *br_name, hal_vlan_id_t &vlan_id);
 
 
@@ -35,5 +45,20 @@ t_std_error nas_com_del_1d_br_untag_vid(const char *br_name);
 
 t_std_error nas_com_set_1d_br_reserved_vid(hal_vlan_id_t vlan_id);
 
+/* Appends the 1D bridges using vlan_id as untagged VLAN id to br_names */
+t_std_error nas_com_get_1d_br_by_untag_vid(hal_vlan_id_t vlan_id, std::vector<std::string> &br_names);
+
+/*
+ * Bulk add/delete/get of untagged VLAN ids. The whole list is processed under one
+ * lock, the result of each entry is returned in its rc and the call fails if any entry failed.
+ */
+t_std_error nas_com_add_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count);
+
+
+t_std_error nas_com_del_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count);
+
+
+t_std_error nas_com_get_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count);
+
 #endif
 
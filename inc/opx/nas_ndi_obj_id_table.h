@@ -41,11 +41,114 @@
 
 #ifdef __cplusplus
 
-#include <unordered_map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace nas {
 
-using ndi_obj_id_table_t = std::unordered_map <npu_id_t, ndi_obj_id_t>;
+/*!
+ * \class ndi_obj_id_table_t
+ * \brief Map of NPU ID to NDI object ID
+ *
+ * Flat array of (NPU ID, NDI object ID) pairs sorted by NPU ID. Tables with
+ * up to INLINE_ENTRIES NPUs are stored inside the object without any heap
+ * allocation. Offers the std::map/unordered_map subset used by NAS objects;
+ * iterators and references are invalidated by insert and erase, and the NPU
+ * ID (first) of an element must not be modified through an iterator.
+ *
+ * This class is NOT thread-safe. It is left to the users of this class.
+ */
+class ndi_obj_id_table_t
+{
+    public:
+        typedef npu_id_t key_type;
+        typedef ndi_obj_id_t mapped_type;
+        typedef std::pair<npu_id_t, ndi_obj_id_t> value_type;
+        typedef value_type* iterator;
+        typedef const value_type* const_iterator;
+        typedef size_t size_type;
+
+        static constexpr size_t INLINE_ENTRIES = 2;
+
+        ndi_obj_id_table_t () noexcept {}
+        ndi_obj_id_table_t (const ndi_obj_id_table_t& src);
+        ndi_obj_id_table_t (ndi_obj_id_table_t&& src) noexcept;
+        ndi_obj_id_table_t& operator= (const ndi_obj_id_table_t& src);
+        ndi_obj_id_table_t& operator= (ndi_obj_id_table_t&& src) noexcept;
+        ~ndi_obj_id_table_t () { if (_data != _inline) delete[] _data; }
+
+        size_t size () const noexcept {return _size;}
+        bool empty () const noexcept {return _size == 0;}
+        void clear () noexcept {_size = 0;}
+        void reserve (size_t n);
+
+        iterator begin () noexcept {return _data;}
+        iterator end () noexcept {return _data + _size;}
+        const_iterator begin () const noexcept {return _data;}
+        const_iterator end () const noexcept {return _data + _size;}
+        const_iterator cbegin () const noexcept {return _data;}
+        const_iterator cend () const noexcept {return _data + _size;}
+
+        iterator find (npu_id_t npu_id) noexcept {
+            iterator it = _lower_bound (npu_id);
+            return (it != end() && it->first == npu_id) ? it : end();
+        }
+        const_iterator find (npu_id_t npu_id) const noexcept {
+            return const_cast<ndi_obj_id_table_t*>(this)->find (npu_id);
+        }
+        size_t count (npu_id_t npu_id) const noexcept {return (find (npu_id) != end()) ? 1 : 0;}
+
+        /*! Exception-free lookup
+         * \param[in] npu_id NPU ID to look up
+         * \param[out] ndi_obj_id NDI object ID mapped to the NPU
+         * \return true if found */
+        bool get (npu_id_t npu_id, ndi_obj_id_t& ndi_obj_id) const noexcept {
+            const_iterator it = find (npu_id);
+            if (it == end()) return false;
+            ndi_obj_id = it->second;
+            return true;
+        }
+
+        /*! Throws std::out_of_range if the NPU ID is not in the table */
+        ndi_obj_id_t& at (npu_id_t npu_id);
+        const ndi_obj_id_t& at (npu_id_t npu_id) const {
+            return const_cast<ndi_obj_id_table_t*>(this)->at (npu_id);
+        }
+
+        ndi_obj_id_t& operator[] (npu_id_t npu_id) {
+            return _insert (npu_id, 0).first->second;
+        }
+
+        std::pair<iterator, bool> insert (const value_type& elem) {
+            return _insert (elem.first, elem.second);
+        }
+        std::pair<iterator, bool> emplace (npu_id_t npu_id, ndi_obj_id_t ndi_obj_id) {
+            return _insert (npu_id, ndi_obj_id);
+        }
+
+        size_t erase (npu_id_t npu_id) noexcept;
+        iterator erase (const_iterator pos) noexcept;
+
+        bool operator== (const ndi_obj_id_table_t& rhs) const noexcept;
+        bool operator!= (const ndi_obj_id_table_t& rhs) const noexcept {return !(*this == rhs);}
+
+    private:
+        // Tables hold a handful of NPUs - a linear scan beats a binary search
+        iterator _lower_bound (npu_id_t npu_id) noexcept {
+            iterator it = begin();
+            while (it != end() && it->first < npu_id) ++it;
+            return it;
+        }
+        std::pair<iterator, bool> _insert (npu_id_t npu_id, ndi_obj_id_t ndi_obj_id);
+        void _copy (const ndi_obj_id_table_t& src);
+        void _move (ndi_obj_id_table_t& src) noexcept;
+
+        uint32_t    _size = 0;
+        uint32_t    _capacity = INLINE_ENTRIES;
+        value_type* _data = _inline;
+        value_type  _inline[INLINE_ENTRIES];
+};
 
 /**
  * Serialize the NDI Object ID table as binary data in a CPS Object attribute
@@ -78,9 +181,29 @@ bool ndi_obj_id_table_cps_serialize (const ndi_obj_id_table_t& table,
                                      cps_api_attr_id_t *attr_id_list,
                                      size_t attr_id_size);
 
+/**
+ * Serialize the NDI Object ID table as a single binary CPS attribute holding
+ * a versioned packed array of (NPU ID, NDI Obj ID) pairs. Much cheaper to
+ * build and parse than the nested attributes of ndi_obj_id_table_cps_serialize.
+ * ndi_obj_id_table_cps_unserialize accepts both encodings.
+ * C++ version.
+ *
+ * @param  table         NDI Obj Id map table that needs to be serialized
+ * @param  cps_obj       CPS object into which the table needs to be serialized
+ * @param  attr_id_list  CPS attribute ID hierarchy within the above CPS object
+ *                         into which the obj ID table is serialized
+ * @param  attr_id_size  Number of CPS attribute IDs in the hierarchy
+ * @return               True if the table was successfully serialized to the CPS object
+ */
+bool ndi_obj_id_table_cps_serialize_compact (const ndi_obj_id_table_t& table,
+                                             cps_api_object_t cps_obj,
+                                             cps_api_attr_id_t *attr_id_list,
+                                             size_t attr_id_size);
+
 /**
  * Overwrite the contents of an NPU ID to NDI Object ID map table with
  * contents generated by unserializing binary data in a CPS object attribute.
+ * Both the nested and the compact encoding are accepted.
  * C++ version.
  *
  * @verbatim
@@ -110,6 +233,45 @@ bool ndi_obj_id_table_cps_unserialize (ndi_obj_id_table_t&  table,
                                        size_t attr_id_size);
 
 
+/**
+ * Serialize many tables at once, table i into the i'th object of a CPS
+ * object list. Objects missing from the list are created and appended.
+ * Scratch buffers are shared by the whole batch and each object is
+ * pre-sized for its table.
+ *
+ * @param  tables        array of pointers to the tables to serialize
+ * @param  count         number of tables
+ * @param  obj_list      CPS object list into which the tables are serialized
+ * @param  attr_id_list  CPS attribute ID hierarchy within each CPS object
+ *                         into which the obj ID table is serialized
+ * @param  attr_id_size  Number of CPS attribute IDs in the hierarchy
+ * @param  compact       use the compact encoding (see ndi_obj_id_table_cps_serialize_compact)
+ * @return               True if all the tables were successfully serialized
+ */
+bool ndi_obj_id_table_cps_serialize_list (const ndi_obj_id_table_t* const tables[],
+                                          size_t count,
+                                          cps_api_object_list_t obj_list,
+                                          cps_api_attr_id_t *attr_id_list,
+                                          size_t attr_id_size,
+                                          bool compact);
+
+/**
+ * Unserialize a table from each object of a CPS object list. tables is
+ * resized to the list size and tables[i] is filled from the i'th object,
+ * or left empty if that object could not be unserialized.
+ *
+ * @param  tables        tables to which the opaque data is unserialized
+ * @param  obj_list      CPS object list from which the tables are unserialized
+ * @param  attr_id_list  CPS attribute ID hierarchy within each CPS object
+ *                         from which the obj ID table is unserialized
+ * @param  attr_id_size  Number of CPS attribute IDs in the hierarchy
+ * @return               Number of objects sucessfully unserialized
+ */
+size_t ndi_obj_id_table_cps_unserialize_list (std::vector<ndi_obj_id_table_t>& tables,
+                                              cps_api_object_list_t obj_list,
+                                              cps_api_attr_id_t *attr_id_list,
+                                              size_t attr_id_size);
+
 }
 
 extern "C" {
@@ -199,9 +361,27 @@ bool nas_ndi_obj_id_table_cps_serialize (const nas_ndi_obj_id_table_handle_t h,
                                          cps_api_attr_id_t *attr_id_list,
                                          size_t attr_id_size);
 
+/**
+ * Serialize the NDI Object ID table in the compact encoding
+ * (see nas::ndi_obj_id_table_cps_serialize_compact).
+ * C version.
+ *
+ * @param   h              Handle to NDI Obj Id map table that needs to be serialized
+ * @param   cps_obj        CPS object into which the table needs to be serialized
+ * @param   attr_id_list   CPS attribute ID hierarchy within the above CPS object
+ *                         into which the obj ID table is serialized
+ * @param   attr_id_size   Number of CPS attribute IDs in the hierarchy
+ * @return                 True if the table was successfully serialized to the CPS object
+ */
+bool nas_ndi_obj_id_table_cps_serialize_compact (const nas_ndi_obj_id_table_handle_t h,
+                                                 cps_api_object_t cps_obj,
+                                                 cps_api_attr_id_t *attr_id_list,
+                                                 size_t attr_id_size);
+
 /**
  * Overwrite the contents of an NPU ID to NDI Object ID map table with
  * contents generated by unserializing binary data in a CPS object attribute.
+ * Both the nested and the compact encoding are accepted.
  * C version.
  *
  * @verbatim
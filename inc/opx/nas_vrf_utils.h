@@ -83,6 +83,47 @@ t_std_error nas_get_vrf_internal_id_from_vrf_name(const char *vrf_name, hal_vrf_
  */
 t_std_error nas_get_vrf_ctrl_from_vrf_name(const char *vrf_name, nas_vrf_ctrl_t *vrf_ctrl_blk);
 
+/*!
+ *  Function to get the VRF ctrl block from a given internal VRF id.
+ *  \param vrf_int_id [in] internal VRF id
+ *  \param vrf_ctrl_blk [out] returns the VRF ctrl block
+ *  \return              std_error
+ */
+t_std_error nas_get_vrf_ctrl_from_vrf_id(hal_vrf_id_t vrf_int_id, nas_vrf_ctrl_t *vrf_ctrl_blk);
+
+/*!
+ *  Function to get the VRF ctrl block from a given VRF object id.
+ *  \param obj_id [in] VRF OID given by NPU
+ *  \param vrf_ctrl_blk [out] returns the VRF ctrl block
+ *  \return              std_error
+ */
+t_std_error nas_get_vrf_ctrl_from_obj_id(nas_obj_id_t obj_id, nas_vrf_ctrl_t *vrf_ctrl_blk);
+
+/*!
+ *  Callback for nas_walk_vrf_ctrl
+ *  \param vrf_ctrl [in] VRF ctrl block, valid only during the callback
+ *  \param context [in] context passed to nas_walk_vrf_ctrl
+ *  \return              true to continue the walk, false to stop
+ */
+typedef bool (*nas_vrf_walk_fn)(const nas_vrf_ctrl_t *vrf_ctrl, void *context);
+
+/*!
+ *  Function to get the VRF table generation number.
+ *  The generation changes on every VRF add/update/delete.
+ *  \return              generation number
+ */
+uint64_t nas_get_vrf_table_gen(void);
+
+/*!
+ *  Function to walk all VRF ctrl blocks without copying them.
+ *  The callback must not add/update/delete VRFs.
+ *  \param fn [in] callback called for each VRF
+ *  \param context [in] passed to the callback
+ *  \param gen [out] if not NULL, returns the generation number of the walked table
+ *  \return              number of VRFs visited
+ */
+size_t nas_walk_vrf_ctrl(nas_vrf_walk_fn fn, void *context, uint64_t *gen);
+
 /*!
  *  Function to add/del the VRF information for the VRF name.
  *  \param op [in] VRF add/del operation.
@@ -24,6 +24,7 @@
 
 #include "dell-base-common.h"
 #include "hal_if_mapping.h"
+#include "hal_if_trace.h"
 #include "iana-if-type.h"
 #include "dell-base-interface-common.h"
 #include "event_log.h"
@@ -51,7 +52,107 @@ static auto if_mappings = *new std::unordered_map<intf_info_t,if_map_t,std::hash
 
 static _key_t INVALID_KEY = (~0);
 
-static std::set<hal_ifindex_t> if_indexes;
+/*
+ * Sparse two-level bitmap over the ifindex space.
+ * Each leaf covers 4096 ifindexes and carries a one-word summary of its
+ * non-empty words, so the successor search inside a leaf is two
+ * find-first-set operations. Leaves are kept in ifindex order so moving
+ * on to the next populated leaf is a single iterator step.
+ */
+class ifindex_bitmap_t {
+    public:
+        void insert (uint32_t ix) {
+            auto& leaf = _leaves[ix >> LEAF_BITS];
+            uint32_t pos = ix & LEAF_MASK;
+            leaf.words[pos >> 6] |= (1ULL << (pos & 63));
+            leaf.summary |= (1ULL << (pos >> 6));
+        }
+
+        void erase (uint32_t ix) {
+            auto it = _leaves.find(ix >> LEAF_BITS);
+            if (it == _leaves.end()) return;
+            auto& leaf = it->second;
+            uint32_t pos = ix & LEAF_MASK;
+            leaf.words[pos >> 6] &= ~(1ULL << (pos & 63));
+            if (leaf.words[pos >> 6] == 0) {
+                leaf.summary &= ~(1ULL << (pos >> 6));
+                if (leaf.summary == 0) _leaves.erase(it);
+            }
+        }
+
+        /* Lowest ifindex in the bitmap */
+        bool first (uint32_t *out) const {
+            if (_leaves.empty()) return false;
+            auto it = _leaves.begin();
+            uint32_t bit = 0;
+            _leaf_next(it->second, 0, &bit);
+            *out = (it->first << LEAF_BITS) | bit;
+            return true;
+        }
+
+        /* Lowest ifindex in the bitmap that is greater than ix */
+        bool next (uint32_t ix, uint32_t *out) const {
+            if (ix == UINT32_MAX) return false;
+            uint32_t start = ix + 1;
+            uint32_t bit = 0;
+            auto it = _leaves.lower_bound(start >> LEAF_BITS);
+            if (it != _leaves.end() && it->first == (start >> LEAF_BITS)) {
+                if (_leaf_next(it->second, start & LEAF_MASK, &bit)) {
+                    *out = (it->first << LEAF_BITS) | bit;
+                    return true;
+                }
+                ++it;
+            }
+            if (it == _leaves.end()) return false;
+            _leaf_next(it->second, 0, &bit);
+            *out = (it->first << LEAF_BITS) | bit;
+            return true;
+        }
+
+    private:
+        static const uint32_t LEAF_BITS = 12;
+        static const uint32_t LEAF_MASK = (1 << LEAF_BITS) - 1;
+
+        struct leaf_t {
+            uint64_t summary = 0;
+            uint64_t words[(1 << LEAF_BITS) / 64] = {};
+        };
+
+        static bool _leaf_next (const leaf_t& leaf, uint32_t pos, uint32_t *bit) {
+            uint32_t w = pos >> 6;
+            uint64_t m = leaf.words[w] & (~0ULL << (pos & 63));
+            if (m == 0) {
+                if (w == 63) return false;
+                uint64_t s = leaf.summary & (~0ULL << (w + 1));
+                if (s == 0) return false;
+                w = __builtin_ctzll(s);
+                m = leaf.words[w];
+            }
+            *bit = (w << 6) | __builtin_ctzll(m);
+            return true;
+        }
+
+        std::map<uint32_t, leaf_t> _leaves;
+};
+
+/* Default VRF ifindexes, used by dn_hal_get_next_ifindex */
+static auto& if_indexes = *new ifindex_bitmap_t;
+
+/* Per interface type index ordered by (vrf, ifindex) */
+using if_type_index_t = std::map<_key_t, interface_ctrl_t *>;
+static auto if_type_indexes = new std::unordered_map<int32_t, if_type_index_t>;
+
+/* Per NPU dense array of mapped port interfaces indexed by port id */
+struct npu_port_table_t {
+    std::vector<interface_ctrl_t *> ports;
+    size_t count = 0;
+};
+static auto if_npu_ports = new std::unordered_map<npu_id_t, npu_port_table_t>;
+
+/* Bounded ring of the latest interface DB changes, protected by db_lock */
+static const size_t INTF_CHANGE_JOURNAL_SZ = 4096;
+static auto if_change_journal = new std::vector<hal_intf_change_t>(INTF_CHANGE_JOURNAL_SZ);
+static uint64_t if_change_seq = 0;
 
 static const intf_info_t _has_key_t[] = {
         HAL_INTF_INFO_FROM_PORT,
@@ -256,11 +357,58 @@ static bool _add(intf_info_t type, interface_ctrl_t *rec) {
         if (k==INVALID_KEY) return false;
         if_mappings[type][k] = rec;
     }
-    if (rec->vrf_id == 0)
-        if_indexes.insert(rec->if_index);
     return true;
 }
 
+/**
+ * Append a change of the record to the change journal
+ */
+static void _journal_add(hal_intf_change_type_t change, const interface_ctrl_t *rec) {
+    hal_intf_change_t& e = (*if_change_journal)[++if_change_seq % INTF_CHANGE_JOURNAL_SZ];
+    e.seq = if_change_seq;
+    e.change = change;
+    e.int_type = rec->int_type;
+    e.vrf_id = rec->vrf_id;
+    e.if_index = rec->if_index;
+}
+
+/**
+ * Add the record to the ordered ifindex indexes
+ */
+static void _index_add(interface_ctrl_t *rec) {
+    if (rec->vrf_id == 0)
+        if_indexes.insert((uint32_t)rec->if_index);
+    (*if_type_indexes)[rec->int_type][_mk_key(rec->vrf_id, rec->if_index)] = rec;
+
+    if (_query_valid(HAL_INTF_INFO_FROM_PORT, rec->int_type) && rec->port_mapped &&
+        rec->port_id >= 0) {
+        auto& tbl = (*if_npu_ports)[rec->npu_id];
+        if ((size_t)rec->port_id >= tbl.ports.size()) {
+            tbl.ports.resize(rec->port_id + 1, nullptr);
+        }
+        if (tbl.ports[rec->port_id] == nullptr) ++tbl.count;
+        tbl.ports[rec->port_id] = rec;
+    }
+}
+
+static void _index_del(interface_ctrl_t *rec) {
+    if (rec->vrf_id == 0)
+        if_indexes.erase((uint32_t)rec->if_index);
+    auto it = if_type_indexes->find(rec->int_type);
+    if (it != if_type_indexes->end()) {
+        it->second.erase(_mk_key(rec->vrf_id, rec->if_index));
+        if (it->second.empty()) if_type_indexes->erase(it);
+    }
+
+    auto npu_it = if_npu_ports->find(rec->npu_id);
+    if (npu_it == if_npu_ports->end() || !rec->port_mapped || rec->port_id < 0) return;
+    auto& tbl = npu_it->second;
+    if ((size_t)rec->port_id < tbl.ports.size() && tbl.ports[rec->port_id] == rec) {
+        tbl.ports[rec->port_id] = nullptr;
+        if (--tbl.count == 0) if_npu_ports->erase(npu_it);
+    }
+}
+
 /**
  * Remove any records associated with this entry
  */
@@ -298,8 +446,8 @@ static void _cleanup(interface_ctrl_t *rec) {
 
     if_records.erase(_rec);
 
-    if (rec->vrf_id == 0)
-        if_indexes.erase(_rec->if_index);
+    _index_del(_rec);
+    _journal_add(HAL_INTF_CHANGE_DEREG, _rec);
     delete _rec;
 }
 
@@ -384,6 +532,10 @@ bool ietf_to_nas_os_if_type_get(const char *ietf_type, BASE_CMN_INTERFACE_TYPE_t
 }
 
 t_std_error dn_hal_if_register(hal_intf_reg_op_type_t reg_opt,interface_ctrl_t *detail) {
+    if (dn_hal_trace_enabled()) {
+        dn_hal_trace_record(reg_opt==HAL_INTF_OP_DEREG ? HAL_IF_TRACE_OP_DEREG : HAL_IF_TRACE_OP_REG,
+                            detail, nullptr);
+    }
     std_rw_lock_write_guard l(&db_lock);
     if (reg_opt==HAL_INTF_OP_DEREG) {
         _cleanup(detail);
@@ -416,12 +568,15 @@ t_std_error dn_hal_if_register(hal_intf_reg_op_type_t reg_opt,interface_ctrl_t *
         if_records.erase(p.get());
         return STD_ERR(INTERFACE,PARAM,0);
     }
+    _index_add(p.get());
+    _journal_add(HAL_INTF_CHANGE_REG, p.get());
     p.release();
     return STD_ERR_OK;
 }
 
 t_std_error dn_hal_get_interface_info(interface_ctrl_t *p) {
     STD_ASSERT(p!=NULL);
+    if (dn_hal_trace_enabled()) dn_hal_trace_record(HAL_IF_TRACE_OP_GET, p, nullptr);
     if (p->q_type == HAL_INTF_INFO_FROM_PORT) {
         // If query interface by its NPU port, the interface
         // should be mapped interface.
@@ -438,22 +593,131 @@ t_std_error dn_hal_get_interface_info(interface_ctrl_t *p) {
 }
 
 t_std_error dn_hal_get_next_ifindex(hal_ifindex_t *ifindex, hal_ifindex_t *next_ifindex) {
+    if (dn_hal_trace_enabled()) {
+        interface_ctrl_t _intf;
+        memset(&_intf, 0, sizeof(_intf));
+        _intf.if_index = (ifindex == nullptr) ? NAS_INVALID_IF_INDEX : *ifindex;
+        dn_hal_trace_record(HAL_IF_TRACE_OP_GET_NEXT_IFINDEX, &_intf, nullptr);
+    }
+
     std_rw_lock_read_guard l(&db_lock);
-    if (ifindex == nullptr) {
-        std::set<hal_ifindex_t>::iterator it = if_indexes.begin();
-        *next_ifindex = *it;
+    uint32_t next = 0;
+    bool found = (ifindex == nullptr) ? if_indexes.first(&next) :
+                                        if_indexes.next((uint32_t)*ifindex, &next);
+    if (found) {
+        *next_ifindex = (hal_ifindex_t)next;
         return STD_ERR_OK;
     }
 
-    auto it = if_indexes.upper_bound(*ifindex);
-    if( it != if_indexes.end()) {
-        *next_ifindex = *it;
-        return STD_ERR_OK;
+    return STD_ERR(INTERFACE,PARAM,0);
+}
+
+t_std_error dn_hal_get_next_intf_by_type(nas_int_type_t if_type, hal_vrf_id_t vrf_id,
+                                         const hal_ifindex_t *ifindex,
+                                         interface_ctrl_t *p) {
+    STD_ASSERT(p!=NULL);
+    std_rw_lock_read_guard l(&db_lock);
+    auto idx = if_type_indexes->find(if_type);
+    if (idx == if_type_indexes->end()) {
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+
+    auto it = (ifindex == nullptr) ? idx->second.lower_bound(_mk_key(vrf_id, 0)) :
+                                     idx->second.upper_bound(_mk_key(vrf_id, *ifindex));
+    if (it == idx->second.end() || (it->first >> 32) != vrf_id) {
+        return STD_ERR(INTERFACE,PARAM,0);
     }
 
+    *p = *it->second;
+    return STD_ERR_OK;
+}
+
+size_t dn_hal_get_npu_port_count(npu_id_t npu_id) {
+    std_rw_lock_read_guard l(&db_lock);
+    auto it = if_npu_ports->find(npu_id);
+    if (it == if_npu_ports->end()) return 0;
+    return it->second.count;
+}
+
+t_std_error dn_hal_get_next_npu_port_intf(npu_id_t npu_id, const npu_port_t *port_id,
+                                          interface_ctrl_t *p) {
+    STD_ASSERT(p!=NULL);
+    std_rw_lock_read_guard l(&db_lock);
+    auto it = if_npu_ports->find(npu_id);
+    if (it == if_npu_ports->end()) {
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+
+    auto& ports = it->second.ports;
+    size_t ix = (port_id == nullptr) ? 0 : (size_t)(*port_id < 0 ? 0 : *port_id + 1);
+    for ( ; ix < ports.size() ; ++ix ) {
+        if (ports[ix] != nullptr) {
+            *p = *ports[ix];
+            return STD_ERR_OK;
+        }
+    }
     return STD_ERR(INTERFACE,PARAM,0);
 }
 
+size_t dn_hal_walk_npu_ports(npu_id_t npu_id, dn_hal_intf_walk_fn fn, void *context) {
+    STD_ASSERT(fn!=NULL);
+    std_rw_lock_read_guard l(&db_lock);
+    auto it = if_npu_ports->find(npu_id);
+    if (it == if_npu_ports->end()) return 0;
+
+    size_t visited = 0;
+    for (auto rec: it->second.ports) {
+        if (rec == nullptr) continue;
+        ++visited;
+        if (!fn(rec, context)) break;
+    }
+    return visited;
+}
+
+uint64_t dn_hal_get_change_seq(void) {
+    std_rw_lock_read_guard l(&db_lock);
+    return if_change_seq;
+}
+
+t_std_error dn_hal_get_changes_since(uint64_t seq, hal_intf_change_t *changes,
+                                     size_t *count, uint64_t *last_seq) {
+    STD_ASSERT(count!=NULL);
+    STD_ASSERT(last_seq!=NULL);
+    std_rw_lock_read_guard l(&db_lock);
+    *last_seq = if_change_seq;
+    if (seq > if_change_seq || (*count > 0 && changes == nullptr)) {
+        *count = 0;
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+
+    /* The changes following seq have been overwritten - caller needs a snapshot */
+    if (if_change_seq - seq > INTF_CHANGE_JOURNAL_SZ) {
+        *count = 0;
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+
+    size_t n = if_change_seq - seq;
+    if (n > *count) n = *count;
+    for (size_t ix = 0; ix < n; ++ix) {
+        changes[ix] = (*if_change_journal)[(seq + ix + 1) % INTF_CHANGE_JOURNAL_SZ];
+    }
+    *count = n;
+    return STD_ERR_OK;
+}
+
+size_t dn_hal_walk_interfaces(dn_hal_intf_walk_fn fn, void *context, uint64_t *seq) {
+    STD_ASSERT(fn!=NULL);
+    std_rw_lock_read_guard l(&db_lock);
+    if (seq != nullptr) *seq = if_change_seq;
+
+    size_t visited = 0;
+    for (auto rec: if_records) {
+        ++visited;
+        if (!fn(rec, context)) break;
+    }
+    return visited;
+}
+
 /*  Update only non- Key attributes like MAC address */
 static t_std_error dn_hal_update_interface(interface_ctrl_t *p) {
     STD_ASSERT(p!=NULL);
@@ -465,6 +729,7 @@ static t_std_error dn_hal_update_interface(interface_ctrl_t *p) {
 
     /* only MAC can be updated in the DB. DEREG and REG should be done for other items. */
     safestrncpy(_p->mac_addr, (const char *)p->mac_addr, sizeof(_p->mac_addr));
+    _journal_add(HAL_INTF_CHANGE_MAC, _p);
     return STD_ERR_OK;
 }
 
@@ -476,6 +741,7 @@ t_std_error dn_hal_update_intf_mac(hal_ifindex_t ifx, const char *mac) {
     _intf.if_index = ifx;
     _intf.q_type = HAL_INTF_INFO_FROM_IF;
     safestrncpy(_intf.mac_addr, mac, sizeof(_intf.mac_addr));
+    if (dn_hal_trace_enabled()) dn_hal_trace_record(HAL_IF_TRACE_OP_UPD_MAC, &_intf, mac);
 
     EV_LOGGING(INTERFACE,INFO,"NAS-IF-REG","OS update for MAC intf  %s MAC %s", _intf.if_name, mac);
     return(dn_hal_update_interface(&_intf));
@@ -486,17 +752,21 @@ t_std_error nas_cmn_update_router_intf_info(hal_vrf_id_t vrf_id, hal_ifindex_t i
                                             l3_intf_info_t *info) {
 
     STD_ASSERT(info!=NULL);
-    std_rw_lock_write_guard l(&db_lock);
     interface_ctrl_t _intf;
     memset(&_intf, 0, sizeof(_intf));
     _intf.vrf_id = vrf_id;
     _intf.if_index = ifx;
     _intf.q_type = HAL_INTF_INFO_FROM_IF;
+    _intf.l3_intf_info = *info;
+    if (dn_hal_trace_enabled()) dn_hal_trace_record(HAL_IF_TRACE_OP_UPD_L3_INFO, &_intf, nullptr);
+
+    std_rw_lock_write_guard l(&db_lock);
     interface_ctrl_t *_p = _locate(_intf.q_type, &_intf);
     if (_p==nullptr) {
         return STD_ERR(INTERFACE,PARAM,0);
     }
     memcpy(&(_p->l3_intf_info), info, sizeof(l3_intf_info_t));
+    _journal_add(HAL_INTF_CHANGE_L3_INFO, _p);
 
     EV_LOGGING(INTERFACE,INFO,"NAS-IF-UPDATE",
                "Update router interface vrf-id:%d if-index:%d for parent interface vrf-id:%d if-index:%d",
@@ -508,6 +778,7 @@ t_std_error dn_hal_update_intf_desc(interface_ctrl_t *p, const char *desc) {
 
     STD_ASSERT(desc!=NULL);
     STD_ASSERT(p!=NULL);
+    if (dn_hal_trace_enabled()) dn_hal_trace_record(HAL_IF_TRACE_OP_UPD_DESC, p, desc);
 
     if (strlen(desc) > MAX_INTF_DESC_LEN) {
         return STD_ERR(INTERFACE, PARAM, 0);
@@ -547,6 +818,7 @@ t_std_error dn_hal_update_intf_desc(interface_ctrl_t *p, const char *desc) {
 
         safestrncpy(_p->desc, desc, desc_len + 1);
     }
+    _journal_add(HAL_INTF_CHANGE_DESC, _p);
 
     EV_LOGGING(INTERFACE,INFO,"NAS-IF-REG","OS update description for intf %s changed to: %s", _p->if_name, desc);
     return STD_ERR_OK;
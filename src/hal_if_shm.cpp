@@ -0,0 +1,572 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * filename: hal_if_shm.cpp
+ **/
+
+/*
+ * Shared memory segment layout -
+ *
+ *   shm_hdr_t      - immutable sizes, offsets of the two copies and the epoch
+ *   copy 0, copy 1 - each holds shm_copy_t followed by one open addressing
+ *                    hash table per query type, the record array and the
+ *                    description pool
+ *
+ * All references inside the segment are offsets or record indexes so the
+ * segment can be mapped at any address. The owner writes the copy readers
+ * are not using and then bumps the epoch; readers pick the copy from the
+ * epoch. A slow reader can still be inside a copy when the owner starts
+ * rewriting it, so each copy also has its own sequence counter: the owner
+ * makes it odd while the copy is written, readers retry when it was odd or
+ * changed while they were reading. Copy contents are only accessed with
+ * relaxed atomic loads and stores.
+ */
+
+#include "hal_if_shm.h"
+#include "hal_if_mapping.h"
+#include "event_log.h"
+#include "std_assert.h"
+#include "std_utils.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory epoch must be lock free");
+
+static const uint32_t HAL_IF_SHM_MAGIC = 0x4e494653;
+static const uint32_t HAL_IF_SHM_VERSION = 2;
+
+/* Number of times a reader retries when the owner publishes under it */
+static const size_t HAL_IF_SHM_READ_RETRIES = 64;
+
+enum {
+    SHM_TBL_IF = 0,
+    SHM_TBL_IF_NAME,
+    SHM_TBL_PORT,
+    SHM_TBL_TAP,
+    SHM_TBL_VLAN,
+    SHM_TBL_LAG,
+    SHM_TBL_BRIDGE,
+    SHM_TBL_MAX
+};
+
+struct shm_hdr_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t max_intfs;
+    uint32_t buckets;
+    uint64_t copy_size;
+    uint64_t copy_off[2];
+    std::atomic<uint64_t> epoch;
+};
+
+struct shm_copy_t {
+    std::atomic<uint64_t> seq;          // odd while the owner writes the copy
+    std::atomic<uint64_t> change_seq;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> desc_used;
+};
+
+struct shm_rec_t {
+    interface_ctrl_t rec;   // desc is always NULL
+    uint32_t desc_off;      // offset of the description in the description pool
+    uint32_t desc_len;      // 0 if there is no description
+};
+
+struct hal_if_shm_s {
+    std::string name;
+    bool owner;
+    uint8_t *base;
+    size_t size;
+    shm_hdr_t *hdr;
+};
+
+/* Hash table slots hold record index + 1, zero is an empty slot */
+using shm_slot_t = uint32_t;
+
+static inline size_t _align(size_t v, size_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+static inline size_t _tables_off() {
+    return _align(sizeof(shm_copy_t), 8);
+}
+
+static inline size_t _recs_off(uint32_t buckets) {
+    return _align(_tables_off() + SHM_TBL_MAX * (size_t)buckets * sizeof(shm_slot_t), 8);
+}
+
+static inline size_t _desc_pool_off(uint32_t max_intfs, uint32_t buckets) {
+    return _recs_off(buckets) + (size_t)max_intfs * sizeof(shm_rec_t);
+}
+
+static inline size_t _copy_size(uint32_t max_intfs, uint32_t buckets) {
+    return _align(_desc_pool_off(max_intfs, buckets) +
+                  (size_t)max_intfs * (MAX_INTF_DESC_LEN + 1), 64);
+}
+
+static inline shm_copy_t *_copy(hal_if_shm_handle_t h, uint64_t epoch) {
+    return (shm_copy_t *)(h->base + h->hdr->copy_off[epoch & 1]);
+}
+
+static inline shm_slot_t *_table(const shm_hdr_t *hdr, shm_copy_t *c, int tbl) {
+    return (shm_slot_t *)((uint8_t *)c + _tables_off()) + (size_t)tbl * hdr->buckets;
+}
+
+static inline shm_rec_t *_recs(const shm_hdr_t *hdr, shm_copy_t *c) {
+    return (shm_rec_t *)((uint8_t *)c + _recs_off(hdr->buckets));
+}
+
+static inline char *_desc_pool(const shm_hdr_t *hdr, shm_copy_t *c) {
+    return (char *)c + _desc_pool_off(hdr->max_intfs, hdr->buckets);
+}
+
+/* Relaxed atomic access to copy contents shared with readers */
+template <typename T>
+static inline T _load(const T *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+static inline void _store(T *p, T v) {
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+/* Copy 8 byte aligned memory a word at a time */
+static void _load_words(void *dst, const void *src, size_t len) {
+    auto d = (uint64_t *)dst;
+    auto s = (const uint64_t *)src;
+    for (size_t ix = 0; ix < len / sizeof(uint64_t); ++ix) d[ix] = _load(&s[ix]);
+}
+
+static void _store_words(void *dst, const void *src, size_t len) {
+    auto d = (uint64_t *)dst;
+    auto s = (const uint64_t *)src;
+    for (size_t ix = 0; ix < len / sizeof(uint64_t); ++ix) _store(&d[ix], s[ix]);
+}
+
+static_assert(sizeof(shm_rec_t) % sizeof(uint64_t) == 0, "shm_rec_t is copied in words");
+
+/* Reader side - returns false if the owner is writing the copy */
+static inline bool _read_begin(shm_copy_t *c, uint64_t *seq) {
+    *seq = c->seq.load(std::memory_order_acquire);
+    return (*seq & 1) == 0;
+}
+
+static inline bool _read_end(shm_copy_t *c, uint64_t seq) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return c->seq.load(std::memory_order_relaxed) == seq;
+}
+
+/* Owner side */
+static void _write_begin(shm_copy_t *c) {
+    c->seq.store(c->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void _write_end(shm_copy_t *c) {
+    c->seq.store(c->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+static inline uint64_t _mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static uint64_t _name_hash(const char *name) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t ix = 0; ix < HAL_IF_NAME_SZ && name[ix] != '\0'; ++ix) {
+        h = (h ^ (uint8_t)name[ix]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int _query_table(intf_info_t q_type) {
+    switch (q_type) {
+    case HAL_INTF_INFO_FROM_IF: return SHM_TBL_IF;
+    case HAL_INTF_INFO_FROM_IF_NAME: return SHM_TBL_IF_NAME;
+    case HAL_INTF_INFO_FROM_PORT: return SHM_TBL_PORT;
+    case HAL_INTF_INFO_FROM_TAP: return SHM_TBL_TAP;
+    case HAL_INTF_INFO_FROM_VLAN: return SHM_TBL_VLAN;
+    case HAL_INTF_INFO_FROM_LAG: return SHM_TBL_LAG;
+    case HAL_INTF_INFO_FROM_BRIDGE_ID: return SHM_TBL_BRIDGE;
+    }
+    return -1;
+}
+
+static inline bool _is_port_type(nas_int_type_t t) {
+    return (t == nas_int_type_PORT || t == nas_int_type_CPU || t == nas_int_type_FC);
+}
+
+/**
+ * Key of the record for the given table, same rules as the keys
+ * of the in-process interface DB in hal_if_mapping.cpp
+ */
+static bool _key(int tbl, const interface_ctrl_t *rec, uint64_t *key) {
+    switch (tbl) {
+    case SHM_TBL_IF:
+        *key = ((uint64_t)rec->vrf_id) << 32 | (uint32_t)rec->if_index;
+        return true;
+    case SHM_TBL_IF_NAME:
+        if (rec->if_name[0] == '\0') return false;
+        *key = _name_hash(rec->if_name);
+        return true;
+    case SHM_TBL_PORT:
+        if (!_is_port_type(rec->int_type) || !rec->port_mapped) return false;
+        *key = ((uint64_t)(uint32_t)rec->npu_id) << 32 | (uint32_t)rec->port_id;
+        return true;
+    case SHM_TBL_TAP:
+        if (!_is_port_type(rec->int_type) || !rec->port_mapped) return false;
+        *key = (uint64_t)rec->tap_id;
+        return true;
+    case SHM_TBL_VLAN:
+        if (rec->int_type != nas_int_type_VLAN) return false;
+        *key = rec->vlan_id;
+        return true;
+    case SHM_TBL_LAG:
+        if (rec->int_type != nas_int_type_LAG) return false;
+        *key = rec->lag_id;
+        return true;
+    case SHM_TBL_BRIDGE:
+        if (rec->int_type != nas_int_type_DOT1D_BRIDGE) return false;
+        *key = rec->bridge_id;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Find the record in a copy. Tolerates a copy being rewritten under it,
+ * the caller validates the result against the sequence of the copy.
+ */
+static bool _find(const shm_hdr_t *hdr, shm_copy_t *c, int tbl,
+                  const interface_ctrl_t *query, uint64_t key, shm_rec_t *out) {
+    shm_slot_t *slots = _table(hdr, c, tbl);
+    shm_rec_t *recs = _recs(hdr, c);
+    uint32_t mask = hdr->buckets - 1;
+    uint32_t pos = _mix(key) & mask;
+
+    for (uint32_t probe = 0; probe < hdr->buckets; ++probe, pos = (pos + 1) & mask) {
+        shm_slot_t slot = _load(&slots[pos]);
+        if (slot == 0) return false;
+        if (slot > hdr->max_intfs) continue;
+
+        _load_words(out, &recs[slot - 1], sizeof(*out));
+        uint64_t rec_key = 0;
+        if (!_key(tbl, &out->rec, &rec_key) || rec_key != key) continue;
+        if (tbl == SHM_TBL_IF_NAME &&
+            strncmp(out->rec.if_name, query->if_name, sizeof(out->rec.if_name)) != 0) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void _insert(const shm_hdr_t *hdr, shm_copy_t *c, int tbl, uint64_t key, uint32_t ix) {
+    shm_slot_t *slots = _table(hdr, c, tbl);
+    uint32_t mask = hdr->buckets - 1;
+    uint32_t pos = _mix(key) & mask;
+    while (_load(&slots[pos]) != 0) pos = (pos + 1) & mask;
+    _store(&slots[pos], (shm_slot_t)(ix + 1));
+}
+
+struct shm_snapshot_t {
+    std::vector<interface_ctrl_t> recs;
+    std::vector<std::string> descs;
+};
+
+static bool _snapshot_rec(const interface_ctrl_t *p, void *context) {
+    auto snap = (shm_snapshot_t *)context;
+    snap->recs.push_back(*p);
+    snap->recs.back().desc = nullptr;
+    snap->descs.emplace_back(p->desc != nullptr ? p->desc : "");
+    return true;
+}
+
+extern "C" {
+
+t_std_error dn_hal_shm_create(const char *name, size_t max_intfs, hal_if_shm_handle_t *h) {
+    STD_ASSERT(name!=NULL);
+    STD_ASSERT(h!=NULL);
+    if (max_intfs == 0 || max_intfs > (UINT32_MAX >> 2)) {
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+
+    uint32_t buckets = 1;
+    while (buckets < 2 * max_intfs) buckets <<= 1;
+    size_t copy_size = _copy_size(max_intfs, buckets);
+    size_t copy_off = _align(sizeof(shm_hdr_t), 64);
+    size_t size = copy_off + 2 * copy_size;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-SHM","Failed to create shared memory %s", name);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-SHM","Failed to size shared memory %s", name);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-SHM","Failed to map shared memory %s", name);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+
+    hal_if_shm_handle_t p = new (std::nothrow) hal_if_shm_s;
+    if (p == nullptr) {
+        munmap(base, size);
+        shm_unlink(name);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    p->name = name;
+    p->owner = true;
+    p->base = (uint8_t *)base;
+    p->size = size;
+    p->hdr = (shm_hdr_t *)base;
+
+    /* Segment is zero filled - both copies are valid empty tables */
+    p->hdr->version = HAL_IF_SHM_VERSION;
+    p->hdr->max_intfs = max_intfs;
+    p->hdr->buckets = buckets;
+    p->hdr->copy_size = copy_size;
+    p->hdr->copy_off[0] = copy_off;
+    p->hdr->copy_off[1] = copy_off + copy_size;
+    p->hdr->epoch.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    p->hdr->magic = HAL_IF_SHM_MAGIC;
+
+    *h = p;
+    return STD_ERR_OK;
+}
+
+t_std_error dn_hal_shm_publish(hal_if_shm_handle_t h) {
+    STD_ASSERT(h!=NULL);
+    if (!h->owner) return STD_ERR(INTERFACE,PARAM,0);
+
+    shm_hdr_t *hdr = h->hdr;
+    uint64_t epoch = hdr->epoch.load(std::memory_order_relaxed);
+    if (epoch != 0 && _copy(h, epoch)->change_seq.load(std::memory_order_relaxed) ==
+                      dn_hal_get_change_seq()) {
+        return STD_ERR_OK;
+    }
+
+    shm_snapshot_t snap;
+    uint64_t seq = 0;
+    try {
+        dn_hal_walk_interfaces(_snapshot_rec, &snap, &seq);
+    } catch (std::bad_alloc&) {
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    if (snap.recs.size() > hdr->max_intfs) {
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-SHM","%lu interfaces exceed shared memory size %u",
+                   (unsigned long)snap.recs.size(), hdr->max_intfs);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+
+    /* Write the copy new readers are not using, slow readers may still be in it */
+    shm_copy_t *c = _copy(h, epoch + 1);
+    _write_begin(c);
+
+    shm_slot_t *slots = _table(hdr, c, 0);
+    for (size_t ix = 0; ix < SHM_TBL_MAX * (size_t)hdr->buckets; ++ix) {
+        _store(&slots[ix], (shm_slot_t)0);
+    }
+    shm_rec_t *recs = _recs(hdr, c);
+    char *pool = _desc_pool(hdr, c);
+    uint32_t desc_used = 0;
+
+    for (uint32_t ix = 0; ix < snap.recs.size(); ++ix) {
+        shm_rec_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.rec = snap.recs[ix];
+        rec.desc_off = desc_used;
+        rec.desc_len = snap.descs[ix].size();
+        _store_words(&recs[ix], &rec, sizeof(rec));
+        const char *desc = snap.descs[ix].c_str();
+        for (uint32_t off = 0; off <= rec.desc_len; ++off) {
+            _store(&pool[desc_used + off], desc[off]);
+        }
+        desc_used += rec.desc_len + 1;
+
+        for (int tbl = 0; tbl < SHM_TBL_MAX; ++tbl) {
+            uint64_t key = 0;
+            if (_key(tbl, &rec.rec, &key)) _insert(hdr, c, tbl, key, ix);
+        }
+    }
+    c->count.store(snap.recs.size(), std::memory_order_relaxed);
+    c->desc_used.store(desc_used, std::memory_order_relaxed);
+    c->change_seq.store(seq, std::memory_order_relaxed);
+
+    _write_end(c);
+    hdr->epoch.store(epoch + 1, std::memory_order_release);
+    return STD_ERR_OK;
+}
+
+t_std_error dn_hal_shm_attach(const char *name, hal_if_shm_handle_t *h) {
+    STD_ASSERT(name!=NULL);
+    STD_ASSERT(h!=NULL);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_hdr_t)) {
+        close(fd);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+
+    const shm_hdr_t *hdr = (const shm_hdr_t *)base;
+    bool valid = (hdr->magic == HAL_IF_SHM_MAGIC && hdr->version == HAL_IF_SHM_VERSION);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && hdr->max_intfs != 0 && hdr->buckets >= hdr->max_intfs &&
+            (hdr->buckets & (hdr->buckets - 1)) == 0 && hdr->copy_size == _copy_size(hdr->max_intfs, hdr->buckets) &&
+            hdr->copy_off[1] == hdr->copy_off[0] + hdr->copy_size &&
+            hdr->copy_off[1] + hdr->copy_size <= (uint64_t)st.st_size;
+
+    hal_if_shm_handle_t p = valid ? new (std::nothrow) hal_if_shm_s : nullptr;
+    if (p == nullptr) {
+        munmap(base, st.st_size);
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-SHM","Invalid shared memory interface DB %s", name);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    p->name = name;
+    p->owner = false;
+    p->base = (uint8_t *)base;
+    p->size = st.st_size;
+    p->hdr = (shm_hdr_t *)base;
+
+    *h = p;
+    return STD_ERR_OK;
+}
+
+t_std_error dn_hal_shm_get_interface_info(hal_if_shm_handle_t h, interface_ctrl_t *p) {
+    STD_ASSERT(h!=NULL);
+    STD_ASSERT(p!=NULL);
+
+    int tbl = _query_table(p->q_type);
+    if (p->q_type == HAL_INTF_INFO_FROM_PORT) {
+        // If query interface by its NPU port, the interface
+        // should be mapped interface.
+        p->port_mapped = true;
+    }
+    uint64_t key = 0;
+    if (tbl < 0 || !_key(tbl, p, &key)) {
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+
+    shm_hdr_t *hdr = h->hdr;
+    shm_rec_t rec;
+    for (size_t retry = 0; retry < HAL_IF_SHM_READ_RETRIES; ++retry) {
+        shm_copy_t *c = _copy(h, hdr->epoch.load(std::memory_order_acquire));
+        uint64_t seq;
+        if (!_read_begin(c, &seq)) continue;
+        bool found = _find(hdr, c, tbl, p, key, &rec);
+        if (!_read_end(c, seq)) continue;
+
+        if (!found) return STD_ERR(INTERFACE,PARAM,0);
+        intf_info_t q_type = p->q_type;
+        *p = rec.rec;
+        p->q_type = q_type;
+        p->desc = nullptr;
+        return STD_ERR_OK;
+    }
+    return STD_ERR(INTERFACE,FAIL,0);
+}
+
+t_std_error dn_hal_shm_get_intf_desc(hal_if_shm_handle_t h, hal_vrf_id_t vrf_id,
+                                     hal_ifindex_t if_index, char *desc, size_t len) {
+    STD_ASSERT(h!=NULL);
+    STD_ASSERT(desc!=NULL);
+    if (len == 0) return STD_ERR(INTERFACE,PARAM,0);
+
+    interface_ctrl_t query;
+    memset(&query, 0, sizeof(query));
+    query.vrf_id = vrf_id;
+    query.if_index = if_index;
+    uint64_t key = 0;
+    _key(SHM_TBL_IF, &query, &key);
+
+    shm_hdr_t *hdr = h->hdr;
+    shm_rec_t rec;
+    for (size_t retry = 0; retry < HAL_IF_SHM_READ_RETRIES; ++retry) {
+        shm_copy_t *c = _copy(h, hdr->epoch.load(std::memory_order_acquire));
+        uint64_t seq;
+        if (!_read_begin(c, &seq)) continue;
+        bool found = _find(hdr, c, SHM_TBL_IF, &query, key, &rec);
+        if (found) {
+            size_t pool_sz = hdr->max_intfs * (MAX_INTF_DESC_LEN + 1);
+            if (rec.desc_off < pool_sz && rec.desc_len < pool_sz - rec.desc_off) {
+                size_t n = rec.desc_len < len - 1 ? rec.desc_len : len - 1;
+                const char *pool = _desc_pool(hdr, c) + rec.desc_off;
+                for (size_t ix = 0; ix < n; ++ix) desc[ix] = _load(&pool[ix]);
+                desc[n] = '\0';
+            } else {
+                desc[0] = '\0';
+            }
+        }
+        if (!_read_end(c, seq)) continue;
+
+        return found ? STD_ERR_OK : STD_ERR(INTERFACE,PARAM,0);
+    }
+    return STD_ERR(INTERFACE,FAIL,0);
+}
+
+uint64_t dn_hal_shm_get_change_seq(hal_if_shm_handle_t h) {
+    STD_ASSERT(h!=NULL);
+    for (size_t retry = 0; retry < HAL_IF_SHM_READ_RETRIES; ++retry) {
+        shm_copy_t *c = _copy(h, h->hdr->epoch.load(std::memory_order_acquire));
+        uint64_t seq;
+        if (!_read_begin(c, &seq)) continue;
+        uint64_t change_seq = c->change_seq.load(std::memory_order_relaxed);
+        if (_read_end(c, seq)) return change_seq;
+    }
+    return 0;
+}
+
+void dn_hal_shm_close(hal_if_shm_handle_t h) {
+    if (h == nullptr) return;
+    munmap(h->base, h->size);
+    if (h->owner) shm_unlink(h->name.c_str());
+    delete h;
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * filename: hal_if_trace.cpp
+ **/
+
+#include "hal_if_trace.h"
+#include "hal_if_mapping.h"
+#include "event_log.h"
+#include "std_envvar.h"
+#include "std_mutex_lock.h"
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+static const size_t TRACE_FILE_BUF_SZ = 1 << 20;
+
+static std_mutex_lock_create_static_init_fast(trace_mutex);
+static FILE *trace_fp = nullptr;
+std::atomic<bool> hal_if_trace_on{false};
+static std::chrono::steady_clock::time_point trace_start;
+
+/* Tracing from the environment is started once, at load time */
+static struct trace_env_init_t {
+    trace_env_init_t() {
+        const char *path = std_getenv(HAL_IF_TRACE_ENV_VAR);
+        if (path != NULL && *path != '\0') {
+            dn_hal_trace_start(path);
+        }
+    }
+} trace_env_init;
+
+extern "C" {
+
+t_std_error dn_hal_trace_start(const char *path) {
+    if (path == NULL) return STD_ERR(INTERFACE,PARAM,0);
+
+    std_mutex_simple_lock_guard lock(&trace_mutex);
+    if (trace_fp != nullptr) {
+        fclose(trace_fp);
+        trace_fp = nullptr;
+    }
+
+    trace_fp = fopen(path, "wb");
+    if (trace_fp == nullptr) {
+        hal_if_trace_on = false;
+        EV_LOGGING(INTERFACE,ERR,"NAS-IF-TRACE","Failed to open trace file %s", path);
+        return STD_ERR(INTERFACE,FAIL,0);
+    }
+    setvbuf(trace_fp, NULL, _IOFBF, TRACE_FILE_BUF_SZ);
+
+    hal_if_trace_file_hdr_t hdr = {HAL_IF_TRACE_MAGIC, HAL_IF_TRACE_VERSION};
+    fwrite(&hdr, sizeof(hdr), 1, trace_fp);
+    trace_start = std::chrono::steady_clock::now();
+    hal_if_trace_on = true;
+    EV_LOGGING(INTERFACE,INFO,"NAS-IF-TRACE","Tracing interface DB calls to %s", path);
+    return STD_ERR_OK;
+}
+
+void dn_hal_trace_stop(void) {
+    std_mutex_simple_lock_guard lock(&trace_mutex);
+    hal_if_trace_on = false;
+    if (trace_fp != nullptr) {
+        fclose(trace_fp);
+        trace_fp = nullptr;
+    }
+}
+
+void dn_hal_trace_record(hal_if_trace_op_t op, const interface_ctrl_t *p, const char *data) {
+    if (!dn_hal_trace_enabled()) return;
+
+    hal_if_trace_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.op = op;
+    rec.q_type = p->q_type;
+    rec.int_type = p->int_type;
+    rec.int_sub_type = p->int_sub_type;
+    rec.vrf_id = p->vrf_id;
+    rec.if_index = p->if_index;
+    rec.npu_id = p->npu_id;
+    rec.tap_id = p->tap_id;
+    rec.sub_interface = p->sub_interface;
+    static_assert(sizeof(rec.ids) == sizeof(p->lag_id), "interface id union size mismatch");
+    memcpy(rec.ids, &p->lag_id, sizeof(rec.ids));
+    rec.l3_vrf_id = p->l3_intf_info.vrf_id;
+    rec.l3_if_index = p->l3_intf_info.if_index;
+    size_t name_len = strnlen(p->if_name, sizeof(p->if_name));
+    rec.name_len = name_len > UINT8_MAX ? UINT8_MAX : name_len;
+    size_t data_len = (data != NULL) ? strnlen(data, MAX_INTF_DESC_LEN) : 0;
+    rec.data_len = data_len;
+
+    std_mutex_simple_lock_guard lock(&trace_mutex);
+    if (trace_fp == nullptr) return;
+    rec.ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - trace_start).count();
+    fwrite(&rec, sizeof(rec), 1, trace_fp);
+    if (rec.name_len > 0) fwrite(p->if_name, rec.name_len, 1, trace_fp);
+    if (rec.data_len > 0) fwrite(data, rec.data_len, 1, trace_fp);
+}
+
+}
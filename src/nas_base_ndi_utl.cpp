@@ -26,6 +26,14 @@
 #include "nas_base_utils.h"
 #include "nas_base_ndi_utl.h"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 namespace nas {
 
 static void _create_obj_npulist_ndi (base_obj_t& obj_new,
@@ -44,6 +52,21 @@ static void _modify_obj_npulist_ndi (base_obj_t& obj_new,
                                      rollback_trakr_t& r_trakr,
                                      bool rolling_back);
 
+static void _rollback_modify_attrs_in_npu (base_obj_t& obj_old,
+                                           const attr_list_t& attr_list,
+                                           npu_id_t npu_id)
+{
+    try {
+        obj_old.rollback_leaf_attrs_in_npu (attr_list, npu_id);
+
+    } catch (base_exception& ne) {
+        EV_LOGGING (NAS_COM, ERR,
+                    obj_old.ev_log_mod_name(),
+                    "Rollback failed: %s: ErrCode %d\n",
+                    ne.err_msg.c_str(), ne.err_code);
+    }
+}
+
 static void _rollback_create_obj_ndi (base_obj_t& obj_new,
                                       rollback_trakr_t& r_trakr);
 
@@ -54,11 +77,196 @@ static void _rollback_modify_obj_ndi (base_obj_t& obj_old,
                                       base_obj_t& obj_new,
                                       rollback_trakr_t& r_trakr);
 
+/////////// Parallel NPU push ///////////
+//
+// Objects that allow it are pushed to all NPUs at once on a pool of
+// worker threads. Each NPU gets a result slot, the results are then
+// handled in NPU order exactly like the sequential loops - every NPU that
+// succeeded is tracked for rollback before the first failure is rethrown.
+
+class npu_worker_pool_t
+{
+    public:
+        ~npu_worker_pool_t () {resize (0);}
+
+        void resize (size_t workers)
+        {
+            {
+                std::lock_guard<std::mutex> l {_mutex};
+                _stop = true;
+            }
+            _cv.notify_all ();
+            for (auto& t: _threads) t.join ();
+            _threads.clear ();
+            _stop = false;
+            for (size_t i = 0; i < workers; i++) {
+                _threads.emplace_back (&npu_worker_pool_t::_run, this);
+            }
+        }
+
+        size_t size () const {return _threads.size ();}
+
+        void submit (std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> l {_mutex};
+                _tasks.push_back (std::move (task));
+            }
+            _cv.notify_one ();
+        }
+
+        static bool in_worker () {return _in_worker;}
+
+    private:
+        void _run ()
+        {
+            _in_worker = true;
+            std::unique_lock<std::mutex> l {_mutex};
+            while (true) {
+                _cv.wait (l, [this] {return _stop || !_tasks.empty ();});
+                if (_tasks.empty ()) break;
+                auto task = std::move (_tasks.front ());
+                _tasks.pop_front ();
+                l.unlock ();
+                task ();
+                l.lock ();
+            }
+        }
+
+        std::mutex                        _mutex;
+        std::condition_variable           _cv;
+        std::deque<std::function<void()>> _tasks;
+        std::vector<std::thread>          _threads;
+        bool                              _stop = false;
+        static thread_local bool          _in_worker;
+};
+
+thread_local bool npu_worker_pool_t::_in_worker = false;
+
+static npu_worker_pool_t& _npu_pool ()
+{
+    static npu_worker_pool_t pool;
+    return pool;
+}
+
+void base_ndi_set_npu_workers (size_t workers)
+{
+    _npu_pool ().resize (workers);
+}
+
+static bool _push_in_parallel (const base_obj_t& obj, const npu_set_t& npu_list)
+{
+    // Push from a worker itself is done in place to never wait on the pool
+    // from inside the pool
+    return obj.push_npus_in_parallel () && npu_list.size () > 1 &&
+        _npu_pool ().size () > 0 && !npu_worker_pool_t::in_worker ();
+}
+
+struct npu_push_result_t
+{
+    npu_id_t            npu_id;
+    bool                pushed = false;
+    ndi_obj_id_t        ndi_obj_id = 0;
+    std::exception_ptr  err;
+};
+
+typedef std::function<bool(npu_id_t, ndi_obj_id_t&)> npu_push_fn_t;
+typedef std::function<void(npu_id_t, ndi_obj_id_t)>  npu_pushed_fn_t;
+
+// Results of all NPUs are collected and handed to pushed on the calling
+// thread after the join, so the push itself never writes the object
+static void _push_npulist_parallel (const base_obj_t& obj,
+                                    const npu_set_t& npu_list,
+                                    const npu_push_fn_t& push,
+                                    rollbk_elem_t r_elem,
+                                    rollback_trakr_t& r_trakr,
+                                    bool rolling_back,
+                                    bool track_failed = false,
+                                    const npu_pushed_fn_t& pushed = nullptr)
+{
+    std::vector<npu_push_result_t> results (npu_list.size ());
+    size_t i = 0;
+    for (auto npu_id: npu_list) results[i++].npu_id = npu_id;
+
+    auto run = [&push] (npu_push_result_t& r) {
+        try {
+            r.pushed = push (r.npu_id, r.ndi_obj_id);
+        } catch (...) {
+            r.err = std::current_exception ();
+        }
+    };
+
+    std::mutex              done_mutex;
+    std::condition_variable done_cv;
+    size_t                  pending = results.size () - 1;
+
+    for (i = 1; i < results.size (); i++) {
+        auto& r = results[i];
+        try {
+            _npu_pool ().submit ([&run, &r, &done_mutex, &done_cv, &pending] {
+                run (r);
+                std::lock_guard<std::mutex> l {done_mutex};
+                if (--pending == 0) done_cv.notify_one ();
+            });
+        } catch (...) {
+            // Could not queue, push in place
+            run (r);
+            std::lock_guard<std::mutex> l {done_mutex};
+            --pending;
+        }
+    }
+    // First NPU is pushed by the committing thread itself
+    run (results[0]);
+    {
+        std::unique_lock<std::mutex> l {done_mutex};
+        done_cv.wait (l, [&pending] {return pending == 0;});
+    }
+
+    std::exception_ptr first_err;
+    for (auto& r: results) {
+        if (r.err) {
+            if (!rolling_back) {
+                if (!first_err) first_err = r.err;
+                if (track_failed) {
+                    // Failed push may be partially programmed
+                    r_elem.npu_id = r.npu_id;
+                    r_trakr.push_back (r_elem);
+                }
+                continue;
+            }
+            try {
+                std::rethrow_exception (r.err);
+            } catch (base_exception& e) {
+                EV_LOGGING (NAS_COM, ERR, obj.ev_log_mod_name(),
+                            "Rollback failed: NPU %d: %s ErrCode: %d \n",
+                            r.npu_id, e.err_msg.c_str(), e.err_code);
+            }
+            continue;
+        }
+        if (r.pushed && pushed) {
+            pushed (r.npu_id, r.ndi_obj_id);
+        }
+        if (r.pushed && !rolling_back) {
+            // Upon successful NDI push, start tracking this for rollback
+            r_elem.npu_id = r.npu_id;
+            r_trakr.push_back (r_elem);
+        }
+    }
+    if (first_err) {
+        std::rethrow_exception (first_err);
+    }
+}
+
 void base_create_obj_ndi (base_obj_t& obj_new, bool rolling_back)
 
 {
     rollback_trakr_t  r_trakr;
 
+    if (auto txn = base_txn_t::current ()) {
+        txn->queue_create (obj_new);
+        return;
+    }
+
     try {
 
         _create_obj_npulist_ndi (obj_new, obj_new.npu_list(), r_trakr,
@@ -78,6 +286,11 @@ void base_delete_obj_ndi (base_obj_t& obj_old, bool rolling_back)
 {
     rollback_trakr_t r_trakr;
 
+    if (auto txn = base_txn_t::current ()) {
+        txn->queue_delete (obj_old);
+        return;
+    }
+
     try {
         _delete_obj_npulist_ndi (obj_old, obj_old.npu_list(), r_trakr,
                                  rolling_back);
@@ -96,6 +309,11 @@ void base_modify_obj_ndi (base_obj_t& obj_new, base_obj_t& obj_old,
     npu_set_t         npus_deleted;
     npu_set_t         npus_unchanged;
 
+    if (auto txn = base_txn_t::current ()) {
+        txn->queue_modify (obj_new, obj_old);
+        return;
+    }
+
     try {
         obj_new.npu_list().compare (obj_old.npu_list(), npus_added, npus_deleted,
                                     npus_unchanged);
@@ -127,6 +345,19 @@ static void _create_obj_npulist_ndi (base_obj_t& obj_new,
 
     auto ndi_obj = obj_new.alloc_fill_ndi_obj (mem_trakr);
 
+    if (_push_in_parallel (obj_new, npu_list)) {
+        _push_npulist_parallel (obj_new, npu_list,
+                                [&obj_new, ndi_obj] (npu_id_t npu_id, ndi_obj_id_t& id) {
+                                    return obj_new.push_create_obj_to_npu_parallel (npu_id,
+                                                                                    ndi_obj, id);
+                                },
+                                {ROLLBK_CREATE_OBJ, 0}, r_trakr, rolling_back, false,
+                                [&obj_new] (npu_id_t npu_id, ndi_obj_id_t id) {
+                                    obj_new.set_pushed_ndi_obj_id (npu_id, id);
+                                });
+        return;
+    }
+
     for (auto npu_id: npu_list) {
         try {
             bool pushed;
@@ -162,6 +393,15 @@ static void _delete_obj_npulist_ndi (base_obj_t& obj_old,
 {
     int npu_count = 0;
 
+    if (_push_in_parallel (obj_old, npu_list)) {
+        _push_npulist_parallel (obj_old, npu_list,
+                                [&obj_old] (npu_id_t npu_id, ndi_obj_id_t&) {
+                                    return obj_old.push_delete_obj_to_npu (npu_id);
+                                },
+                                {ROLLBK_DELETE_OBJ, 0}, r_trakr, rolling_back);
+        return;
+    }
+
     for (auto npu_id: npu_list) {
         try {
             bool pushed;
@@ -193,50 +433,96 @@ static void _delete_obj_npulist_ndi (base_obj_t& obj_old,
 }
 
 
-static void _modify_obj_npulist_ndi (base_obj_t& obj_new,
-                                     base_obj_t& obj_old,
-                                     const npu_set_t& npu_list,
-                                     rollback_trakr_t& r_trakr,
-                                     bool rolling_back)
+// Push a run of consecutive dirty leaf attributes to each NPU as one batch
+static void _push_leaf_attrs_npulist (base_obj_t& obj_new,
+                                      const attr_list_t& leaf_attrs,
+                                      const npu_set_t& npu_list,
+                                      rollback_trakr_t& r_trakr,
+                                      bool rolling_back)
 {
-    // Existing NPUs in Modify request
-    for (auto attr_id: obj_new.dirty_attr_list ()) {
+    if (leaf_attrs.empty ()) return;
 
-        if (obj_new.is_leaf_attr (attr_id)) {
+    if (_push_in_parallel (obj_new, npu_list)) {
 
-            for (auto npu_id:  npu_list) {
-
-                try {
-                    if (!obj_new.push_leaf_attr_to_npu (attr_id, npu_id))
-                        // Not pushed to this NPU
-                        continue;
-
-                } catch (base_exception& e) {
-                    if (rolling_back) {
-                        EV_LOGGING (NAS_COM, ERR,
-                                    obj_new.ev_log_mod_name(),
-                                    "Rollback failed: NPU %d: %s ErrCode: %d \n",
-                                    npu_id, e.err_msg.c_str(), e.err_code);
-                    } else {
-                        throw;
-                    }
-                }
+        _push_npulist_parallel (obj_new, npu_list,
+                                [&obj_new, &leaf_attrs] (npu_id_t npu_id, ndi_obj_id_t&) {
+                                    return obj_new.push_leaf_attrs_to_npu (leaf_attrs, npu_id);
+                                },
+                                {ROLLBK_MODIFY_ATTRS, 0, leaf_attrs}, r_trakr,
+                                rolling_back, true);
+        return;
+    }
 
-                if (!rolling_back) {
-                    // Upon successful NDI modification, start tracking this
-                    // for rollback
-                    rollbk_elem_t r_elem {ROLLBK_MODIFY_ATTR, npu_id,
-                        {attr_id}};
-                    r_trakr.push_back (r_elem);
-                }
+    // Existing NPUs in Modify request
+    for (auto npu_id:  npu_list) {
+
+        try {
+            if (!obj_new.push_leaf_attrs_to_npu (leaf_attrs, npu_id))
+                // Not pushed to this NPU
+                continue;
+
+        } catch (base_exception& e) {
+            if (rolling_back) {
+                EV_LOGGING (NAS_COM, ERR,
+                            obj_new.ev_log_mod_name(),
+                            "Rollback failed: NPU %d: %s ErrCode: %d \n",
+                            npu_id, e.err_msg.c_str(), e.err_code);
+            } else {
+                // Batch may be partially programmed, roll it back too
+                rollbk_elem_t r_elem {ROLLBK_MODIFY_ATTRS, npu_id, leaf_attrs};
+                r_trakr.push_back (r_elem);
+                throw;
             }
-        } else {
-            obj_new.push_non_leaf_attr_ndi (attr_id, obj_old,
-                                            npu_list, r_trakr, rolling_back);
+        }
+
+        if (!rolling_back) {
+            // Upon successful NDI modification, start tracking this
+            // for rollback
+            rollbk_elem_t r_elem {ROLLBK_MODIFY_ATTRS, npu_id, leaf_attrs};
+            r_trakr.push_back (r_elem);
         }
     }
 }
 
+// Attributes are pushed in dirty attribute order, runs of
+// consecutive leaf attributes are batched
+static void _modify_attrs_npulist_ndi (base_obj_t& obj_new,
+                                       base_obj_t& obj_old,
+                                       const attr_set_t& dirty_attrs,
+                                       const npu_set_t& npu_list,
+                                       rollback_trakr_t& r_trakr,
+                                       bool rolling_back)
+{
+    attr_list_t leaf_attrs;
+    for (auto attr_id: dirty_attrs) {
+
+        if (obj_new.is_leaf_attr (attr_id)) {
+            leaf_attrs.push_back (attr_id);
+            continue;
+        }
+
+        _push_leaf_attrs_npulist (obj_new, leaf_attrs, npu_list, r_trakr,
+                                  rolling_back);
+        leaf_attrs.clear ();
+
+        obj_new.push_non_leaf_attr_ndi (attr_id, obj_old,
+                                        npu_list, r_trakr, rolling_back);
+    }
+
+    _push_leaf_attrs_npulist (obj_new, leaf_attrs, npu_list, r_trakr,
+                              rolling_back);
+}
+
+static void _modify_obj_npulist_ndi (base_obj_t& obj_new,
+                                     base_obj_t& obj_old,
+                                     const npu_set_t& npu_list,
+                                     rollback_trakr_t& r_trakr,
+                                     bool rolling_back)
+{
+    _modify_attrs_npulist_ndi (obj_new, obj_old, obj_new.dirty_attr_list (),
+                               npu_list, r_trakr, rolling_back);
+}
+
 static void _rollback_create_obj_in_npu (base_obj_t& obj_new, npu_id_t npu_id)
 {
     try {
@@ -313,6 +599,52 @@ static void _rollback_delete_obj_ndi (base_obj_t& obj_old,
     }
 }
 
+static void _rollback_elem_ndi (base_obj_t& obj_old,
+                                base_obj_t& obj_new,
+                                const rollbk_elem_t& r_elem,
+                                void*& ndi_obj,
+                                mem_alloc_helper_t& mem_trakr)
+{
+    switch (r_elem.rlbk_type)
+    {
+        case ROLLBK_CREATE_OBJ:
+            // Delete new table from NDI for NPU
+            _rollback_create_obj_in_npu (obj_new, r_elem.npu_id);
+            break;
+        case ROLLBK_DELETE_OBJ:
+            // Create old table back in NDI for NPU
+            if (!ndi_obj) ndi_obj = obj_old.alloc_fill_ndi_obj (mem_trakr);
+            _rollback_delete_obj_in_npu (obj_old, r_elem.npu_id, ndi_obj);
+            break;
+        case ROLLBK_MODIFY_ATTR:
+            // Restore old object back in NDI
+            if (r_elem.attr_hierarchy.size() == 1) {
+                _rollback_modify_attr_in_npu (obj_old,
+                                              r_elem.attr_hierarchy[0],
+                                              r_elem.npu_id);
+            } else {
+                obj_old.rollback_non_leaf_attr_in_npu (r_elem.attr_hierarchy,
+                                                       r_elem.npu_id,
+                                                       obj_new);
+            }
+            break;
+        case ROLLBK_CREATE_ATTR:
+            // Restore old object back in NDI
+            obj_new.rollback_create_attr_in_npu (r_elem.attr_hierarchy,
+                                                 r_elem.npu_id);
+            break;
+        case ROLLBK_DELETE_ATTR:
+            obj_old.rollback_delete_attr_in_npu (r_elem.attr_hierarchy,
+                                                 r_elem.npu_id);
+            break;
+        case ROLLBK_MODIFY_ATTRS:
+            // Restore old values of the leaf attribute batch
+            _rollback_modify_attrs_in_npu (obj_old, r_elem.attr_hierarchy,
+                                           r_elem.npu_id);
+            break;
+    }
+}
+
 static void _rollback_modify_obj_ndi (base_obj_t& obj_old,
                                       base_obj_t& obj_new,
                                       rollback_trakr_t& r_trakr)
@@ -323,43 +655,324 @@ static void _rollback_modify_obj_ndi (base_obj_t& obj_old,
     // Reverse Loop thru the rollback tracker list
     // and handle each rollback element
     while (r_trakr.size()>0) {
-        auto& r_elem = r_trakr.back();
+        _rollback_elem_ndi (obj_old, obj_new, r_trakr.back(), ndi_obj, mem_trakr);
+        r_trakr.pop_back();
+    }
+}
+
+
+/////////// base_txn_t implementation ///////////
+//
+static thread_local base_txn_t* _current_txn = nullptr;
+
+// Queue the NDI push of the object commit run in this scope to a transaction
+class txn_scope_t
+{
+    public:
+        txn_scope_t (base_txn_t* txn) : _prev (_current_txn) {_current_txn = txn;}
+        ~txn_scope_t () {_current_txn = _prev;}
+    private:
+        base_txn_t* _prev;
+};
+
+base_txn_t* base_txn_t::current ()
+{
+    return _current_txn;
+}
+
+// Keep the bookkeeping of obj from before its add in the op queued for it
+// Run the object's commit with its NDI push queued to this transaction.
+// Its bookkeeping from before is kept in the op queued for it, nothing
+// stays queued if the commit throws.
+template <typename F>
+void base_txn_t::_add (base_obj_t& obj, F commit)
+{
+    txn_scope_t scope {this};
+    size_t first_op = _ops.size ();
+    auto state = obj.save_commit_state ();
+
+    try {
+        commit ();
+    } catch (...) {
+        _ops.resize (first_op);
+        obj.restore_commit_state (state);
+        throw;
+    }
+
+    for (size_t i = first_op; i < _ops.size (); i++) {
+        auto& op = _ops[i];
+        if ((op.type == TXN_DELETE ? op.obj_old : op.obj_new) == &obj) {
+            op.saved = state;
+            op.has_saved = true;
+            return;
+        }
+    }
+}
 
-        switch (r_elem.rlbk_type)
+void base_txn_t::_check_not_created (const base_obj_t& obj_old, const char* fn) const
+{
+    for (auto& op: _ops) {
+        if (op.type == TXN_CREATE && op.obj_new == &obj_old) {
+            throw base_exception {NAS_BASE_E_PARAM, fn,
+                                  "Object created in this transaction cannot be "
+                                  "modified or deleted before commit"};
+        }
+    }
+}
+
+void base_txn_t::add_create (base_obj_t& obj_new)
+{
+    _add (obj_new, [&obj_new] {obj_new.commit_create (false);});
+}
+
+attr_set_t base_txn_t::add_modify (base_obj_t& obj_new, base_obj_t& obj_old)
+{
+    _check_not_created (obj_old, __PRETTY_FUNCTION__);
+    attr_set_t modified_attrs;
+    _add (obj_new, [&] {modified_attrs = obj_new.commit_modify (obj_old, false);});
+    return modified_attrs;
+}
+
+void base_txn_t::add_delete (base_obj_t& obj_old)
+{
+    _check_not_created (obj_old, __PRETTY_FUNCTION__);
+    _add (obj_old, [&obj_old] {obj_old.commit_delete (false);});
+}
+
+void base_txn_t::queue_create (base_obj_t& obj_new)
+{
+    txn_op_t op;
+    op.type = TXN_CREATE;
+    op.obj_new = &obj_new;
+    op.obj_old = nullptr;
+    op.npus_added = obj_new.npu_list();
+    _ops.push_back (std::move (op));
+}
+
+void base_txn_t::queue_modify (base_obj_t& obj_new, base_obj_t& obj_old)
+{
+    txn_op_t op;
+    op.type = TXN_MODIFY;
+    op.obj_new = &obj_new;
+    op.obj_old = &obj_old;
+    op.dirty_attrs = obj_new.dirty_attr_list();
+    obj_new.npu_list().compare (obj_old.npu_list(), op.npus_added, op.npus_deleted,
+                                op.npus_unchanged);
+    _ops.push_back (std::move (op));
+}
+
+void base_txn_t::queue_delete (base_obj_t& obj_old)
+{
+    txn_op_t op;
+    op.type = TXN_DELETE;
+    op.obj_new = nullptr;
+    op.obj_old = &obj_old;
+    op.npus_deleted = obj_old.npu_list();
+    _ops.push_back (std::move (op));
+}
+
+void base_txn_t::_push_npu (size_t op_idx, npu_id_t npu_id,
+                            mem_alloc_helper_t& mem_trakr)
+{
+    auto& op = _ops[op_idx];
+
+    if (op.npus_added.contains (npu_id)) {
+        if (!op.ndi_obj_filled) {
+            // Filled once for all NPUs, after the earlier ops of this NPU
+            op.ndi_obj = op.obj_new->alloc_fill_ndi_obj (mem_trakr);
+            op.ndi_obj_filled = true;
+        }
+        if (op.obj_new->push_create_obj_to_npu (npu_id, op.ndi_obj)) {
+            _journal.push_back ({op_idx, {ROLLBK_CREATE_OBJ, npu_id}});
+        }
+    } else if (op.npus_deleted.contains (npu_id)) {
+        if (op.obj_old->push_delete_obj_to_npu (npu_id)) {
+            _journal.push_back ({op_idx, {ROLLBK_DELETE_OBJ, npu_id}});
+        }
+    } else if (op.npus_unchanged.contains (npu_id)) {
+        npu_set_t npu;
+        npu.add (npu_id);
+        rollback_trakr_t r_trakr;
+        try {
+            // Dirty flags of the object are cleared once it is queued
+            _modify_attrs_npulist_ndi (*op.obj_new, *op.obj_old, op.dirty_attrs,
+                                       npu, r_trakr, false);
+        } catch (base_exception& e) {
+            for (auto& r_elem: r_trakr) _journal.push_back ({op_idx, r_elem});
+            throw;
+        }
+        for (auto& r_elem: r_trakr) _journal.push_back ({op_idx, r_elem});
+    }
+}
+
+void base_txn_t::_rollback (mem_alloc_helper_t& mem_trakr)
+{
+    while (_journal.size () > 0) {
+        auto& j = _journal.back ();
+        auto& op = _ops[j.op];
+        base_obj_t& obj_new = op.obj_new ? *op.obj_new : *op.obj_old;
+        base_obj_t& obj_old = op.obj_old ? *op.obj_old : *op.obj_new;
+        _rollback_elem_ndi (obj_old, obj_new, j.elem, op.old_ndi_obj, mem_trakr);
+        _journal.pop_back ();
+    }
+}
+
+void base_txn_t::commit ()
+{
+    // Pushes from inside the commit, eg of dependent objects, go to NDI
+    txn_scope_t scope {nullptr};
+    mem_alloc_helper_t mem_trakr;
+    npu_set_t all_npus;
+
+    for (auto& op: _ops) {
+        for (auto npu_set: {&op.npus_added, &op.npus_deleted, &op.npus_unchanged}) {
+            for (auto npu_id: *npu_set) all_npus.add (npu_id);
+        }
+    }
+    _journal.reserve (_ops.size () * all_npus.size ());
+
+    try {
+        for (auto npu_id: all_npus) {
+            for (size_t i = 0; i < _ops.size (); i++) {
+                _push_npu (i, npu_id, mem_trakr);
+            }
+        }
+    } catch (base_exception& e) {
+        EV_LOGGING (NAS_COM, ERR, "NAS-TXN",
+                    "Transaction of %zu objects failed, rolling back %zu changes: %s\n",
+                    _ops.size (), _journal.size (), e.err_msg.c_str());
+        _rollback (mem_trakr);
+        // Objects describe the state before they were added again
+        for (auto op = _ops.rbegin (); op != _ops.rend (); ++op) {
+            if (!op->has_saved) continue;
+            auto obj = (op->type == TXN_DELETE) ? op->obj_old : op->obj_new;
+            obj->restore_commit_state (op->saved);
+        }
+        _ops.clear ();
+        throw;
+    }
+
+    for (auto& op: _ops) {
+        if (op.type == TXN_CREATE) op.obj_new->mark_ndi_created ();
+    }
+    _ops.clear ();
+    _journal.clear ();
+}
+
+
+/////////// Asynchronous commit ///////////
+//
+// Each executor worker has its own queue and every order key always maps
+// to the same worker, so commits with the same key run in queue order.
+
+class commit_executor_t
+{
+    public:
+        ~commit_executor_t () {resize (0);}
+
+        void resize (size_t workers)
         {
-            case ROLLBK_CREATE_OBJ:
-                // Delete new table from NDI for NPU
-                _rollback_create_obj_in_npu (obj_new, r_elem.npu_id);
-                break;
-            case ROLLBK_DELETE_OBJ:
-                // Create old table back in NDI for NPU
-                if (!ndi_obj) ndi_obj = obj_old.alloc_fill_ndi_obj (mem_trakr);
-                _rollback_delete_obj_in_npu (obj_old, r_elem.npu_id, ndi_obj);
-                break;
-            case ROLLBK_MODIFY_ATTR:
-                // Restore old object back in NDI
-                if (r_elem.attr_hierarchy.size() == 1) {
-                    _rollback_modify_attr_in_npu (obj_old,
-                                                  r_elem.attr_hierarchy[0],
-                                                  r_elem.npu_id);
-                } else {
-                    obj_old.rollback_non_leaf_attr_in_npu (r_elem.attr_hierarchy,
-                                                           r_elem.npu_id,
-                                                           obj_new);
+            for (auto& w: _workers) {
+                {
+                    std::lock_guard<std::mutex> l {w->mutex};
+                    w->stop = true;
                 }
-                break;
-            case ROLLBK_CREATE_ATTR:
-                // Restore old object back in NDI
-                obj_new.rollback_create_attr_in_npu (r_elem.attr_hierarchy,
-                                                     r_elem.npu_id);
-                break;
-            case ROLLBK_DELETE_ATTR:
-                obj_old.rollback_delete_attr_in_npu (r_elem.attr_hierarchy,
-                                                     r_elem.npu_id);
-                break;
+                w->cv.notify_one ();
+                w->thread.join ();
+            }
+            _workers.clear ();
+            for (size_t i = 0; i < workers; i++) {
+                _workers.emplace_back (new worker_t);
+                auto w = _workers.back ().get ();
+                w->thread = std::thread (&commit_executor_t::_run, w);
+            }
         }
-        r_trakr.pop_back();
+
+        /* False when there are no workers */
+        bool submit (uint64_t key, std::function<void()> task)
+        {
+            if (_workers.empty ()) return false;
+            auto& w = *_workers[(key * 0x9e3779b97f4a7c15ULL >> 32) % _workers.size ()];
+            {
+                std::lock_guard<std::mutex> l {w.mutex};
+                w.tasks.push_back (std::move (task));
+            }
+            w.cv.notify_one ();
+            return true;
+        }
+
+    private:
+        struct worker_t {
+            std::mutex                        mutex;
+            std::condition_variable           cv;
+            std::deque<std::function<void()>> tasks;
+            std::thread                       thread;
+            bool                              stop = false;
+        };
+
+        static void _run (worker_t* w)
+        {
+            std::unique_lock<std::mutex> l {w->mutex};
+            while (true) {
+                w->cv.wait (l, [w] {return w->stop || !w->tasks.empty ();});
+                if (w->tasks.empty ()) break;
+                auto task = std::move (w->tasks.front ());
+                w->tasks.pop_front ();
+                l.unlock ();
+                task ();
+                l.lock ();
+            }
+        }
+
+        std::vector<std::unique_ptr<worker_t>> _workers;
+};
+
+static commit_executor_t& _commit_executor ()
+{
+    static commit_executor_t executor;
+    return executor;
+}
+
+void base_ndi_set_commit_workers (size_t workers)
+{
+    _commit_executor ().resize (workers);
+}
+
+template <typename R, typename F>
+static std::future<R> _commit_async (const base_obj_t& obj, uint64_t order_key, F commit)
+{
+    auto task = std::make_shared<std::packaged_task<R()>> (commit);
+    auto result = task->get_future ();
+    if (order_key == 0) order_key = (uintptr_t) &obj;
+    if (!_commit_executor ().submit (order_key, [task] {(*task) ();})) {
+        (*task) ();
     }
+    return result;
+}
+
+std::future<void> base_commit_create_async (base_obj_t& obj_new, bool rolling_back,
+                                            uint64_t order_key)
+{
+    return _commit_async<void> (obj_new, order_key, [&obj_new, rolling_back] {
+        obj_new.commit_create (rolling_back);
+    });
+}
+
+std::future<attr_set_t> base_commit_modify_async (base_obj_t& obj_new, base_obj_t& obj_old,
+                                                  bool rolling_back, uint64_t order_key)
+{
+    // obj_new is usually a temporary copy, obj_old is the lasting object
+    return _commit_async<attr_set_t> (obj_old, order_key, [&obj_new, &obj_old, rolling_back] {
+        return obj_new.commit_modify (obj_old, rolling_back);
+    });
+}
+
+std::future<void> base_commit_delete_async (base_obj_t& obj_old, bool rolling_back,
+                                            uint64_t order_key)
+{
+    return _commit_async<void> (obj_old, order_key, [&obj_old, rolling_back] {
+        obj_old.commit_delete (rolling_back);
+    });
 }
 
 }
@@ -26,9 +26,19 @@
 #include "nas_base_ndi_utl.h"
 #include "nas_types.h"
 
+#include <atomic>
+
 nas::base_obj_t::~base_obj_t () {};
 nas::base_switch_t::~base_switch_t () {};
 
+// Leaf attribute pushes skipped across all objects
+static std::atomic<uint64_t> _skipped_attr_pushes {0};
+
+uint64_t nas::base_obj_t::skipped_attr_pushes ()
+{
+    return _skipped_attr_pushes.load (std::memory_order_relaxed);
+}
+
 void nas::base_obj_t::add_npu (npu_id_t npu_id, bool reset)
 {
     const npu_set_t& all_npus = _switch_p->npu_list();
@@ -87,6 +97,30 @@ nas::attr_set_t nas::base_obj_t::commit_modify (nas::base_obj_t& obj_old, bool r
         _npus = _switch_p->npu_list();
     }
 
+    if (!rolling_back) {
+        // Drop attributes set to the value they already have.
+        // Rollback always pushes to restore the old values
+        attr_list_t unchanged;
+        for (auto attr_id: _dirty_attributes) {
+            if (is_leaf_attr (attr_id) &&
+                obj_old.set_attr_list().contains (attr_id) &&
+                attr_equal (attr_id, obj_old)) {
+                unchanged.push_back (attr_id);
+            }
+        }
+
+        if (!unchanged.empty ()) {
+            // Only NPUs that already have the object would have been pushed
+            uint64_t npu_count = 0;
+            for (auto npu_id: npu_list ()) {
+                if (obj_old.npu_list().contains (npu_id)) ++npu_count;
+            }
+            for (auto attr_id: unchanged) _dirty_attributes.del (attr_id);
+            _skipped_attr_pushes.fetch_add (unchanged.size () * npu_count,
+                                            std::memory_order_relaxed);
+        }
+    }
+
     nas::base_modify_obj_ndi (*this, obj_old, rolling_back);
 
     nas::attr_set_t modified_attrs = _dirty_attributes;
@@ -107,3 +141,29 @@ void nas::base_obj_t::commit_delete (bool rolling_back)
 
     clear_all_dirty_flags ();
 }
+
+bool nas::base_obj_t::push_leaf_attrs_to_npu (const attr_list_t& attr_list,
+                                              npu_id_t npu_id)
+{
+    bool pushed = false;
+    for (auto attr_id: attr_list) {
+        pushed |= push_leaf_attr_to_npu (attr_id, npu_id);
+    }
+    return pushed;
+}
+
+void nas::base_obj_t::rollback_leaf_attrs_in_npu (const attr_list_t& attr_list,
+                                                  npu_id_t npu_id)
+{
+    for (auto attr_id: attr_list) {
+        try {
+            push_leaf_attr_to_npu (attr_id, npu_id);
+
+        } catch (base_exception& ne) {
+            EV_LOGGING (NAS_COM, ERR, ev_log_mod_name(),
+                        "Rollback failed: NPU %d Attr %lu: %s: ErrCode %d\n",
+                        npu_id, (unsigned long) attr_id,
+                        ne.err_msg.c_str(), ne.err_code);
+        }
+    }
+}
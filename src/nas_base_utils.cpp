@@ -24,24 +24,147 @@
 #include "nas_types.h"
 #include <string>
 
+/////////// mem_alloc_helper_t implementation ///////////
+//
+constexpr size_t nas::mem_alloc_helper_t::INLINE_BYTES;
+
+nas::mem_alloc_helper_t::~mem_alloc_helper_t ()
+{
+    while (_blocks != nullptr) {
+        block_t* next = _blocks->next;
+        NAS_MEM_ALLOC_HELPER_LOG ("Free block %p\r\n", _blocks);
+        free (_blocks);
+        _blocks = next;
+    }
+    for (auto ptr: ptr_list) {
+        NAS_MEM_ALLOC_HELPER_LOG ("Free %p\r\n", ptr);
+        free (ptr);
+    }
+}
+
+void nas::mem_alloc_helper_t::_grow (size_t bytes, size_t align)
+{
+    size_t need = bytes + align;
+    if (need < bytes || need > SIZE_MAX - sizeof (block_t)) throw std::bad_alloc{};
+    size_t size = std::max (_next_block_size, need);
+
+    auto block = static_cast<block_t*> (malloc (sizeof (block_t) + size));
+    if (block == nullptr) throw std::bad_alloc{};
+    NAS_MEM_ALLOC_HELPER_LOG ("Alloc block %p size %zu\r\n", block, size);
+
+    block->next = _blocks;
+    block->size = size;
+    _blocks = block;
+    _cur = (uintptr_t) (block + 1);
+    _end = _cur + size;
+    if (_next_block_size <= SIZE_MAX / 2) _next_block_size *= 2;
+}
+
 /////////// attr_set_t implementation ///////////
 //
+constexpr size_t nas::attr_set_t::WINDOW_WORDS;
+constexpr size_t nas::attr_set_t::WINDOW_BITS;
+
 void nas::attr_set_t:: add (nas_attr_id_t attr_id)
 {
-    _attributes.insert (attr_id);
+    if (!_base_valid) {
+        _base = attr_id - (attr_id % WINDOW_BITS);
+        _base_valid = true;
+    }
+    if (_in_window (attr_id)) {
+        size_t bit = attr_id - _base;
+        _window[bit / 64] |= (1ULL << (bit % 64));
+    } else {
+        _sparse.insert (attr_id);
+    }
     if (attr_id > _max_attr_id) _max_attr_id = attr_id;
 }
 
+void nas::attr_set_t::del (nas_attr_id_t attr_id)
+{
+    if (_in_window (attr_id)) {
+        size_t bit = attr_id - _base;
+        _window[bit / 64] &= ~(1ULL << (bit % 64));
+    } else {
+        _sparse.erase (attr_id);
+    }
+    if (attr_id == _max_attr_id) _recompute_max ();
+}
+
+void nas::attr_set_t::_recompute_max ()
+{
+    _max_attr_id = _sparse.empty () ? 0 : *_sparse.rbegin ();
+    for (size_t w = WINDOW_WORDS; w-- > 0; ) {
+        if (_window[w] != 0) {
+            nas_attr_id_t top = _base + w * 64 + 63 - __builtin_clzll (_window[w]);
+            if (top > _max_attr_id) _max_attr_id = top;
+            break;
+        }
+    }
+}
+
 void nas::attr_set_t::clear ()
 {
-    _attributes.clear ();
+    for (auto& word: _window) word = 0;
+    _sparse.clear ();
     _max_attr_id = 0;
 }
 
+size_t nas::attr_set_t::size () const
+{
+    size_t count = _sparse.size ();
+    for (auto word: _window) {
+        count += __builtin_popcountll (word);
+    }
+    return count;
+}
+
+size_t nas::attr_set_t::_next_bit (size_t bit) const
+{
+    for (size_t w = bit / 64; w < WINDOW_WORDS; w++) {
+        uint64_t word = _window[w];
+        if (w == bit / 64) word &= (~0ULL << (bit % 64));
+        if (word != 0) return w * 64 + __builtin_ctzll (word);
+    }
+    return WINDOW_BITS;
+}
+
+/* Sparse IDs below the window, then the window, then sparse IDs above it */
+nas::attr_set_t::const_iterator nas::attr_set_t::begin () const
+{
+    auto sit = _sparse.begin ();
+    if (sit != _sparse.end () && *sit < _base) {
+        return const_iterator (this, WINDOW_BITS, sit);
+    }
+    return const_iterator (this, _next_bit (0), sit);
+}
+
+nas::attr_set_t::const_iterator& nas::attr_set_t::const_iterator::operator++ ()
+{
+    if (_bit < WINDOW_BITS) {
+        _bit = _set->_next_bit (_bit + 1);
+        return *this;
+    }
+    bool below = (*_sit < _set->_base);
+    ++_sit;
+    if (below && (_sit == _set->_sparse.end () || *_sit > _set->_base)) {
+        // Crossed from the sparse IDs below the window into the window
+        _bit = _set->_next_bit (0);
+    }
+    return *this;
+}
+
 nas::attr_set_t& nas::attr_set_t::operator+= (const nas::attr_set_t& rhs)
 {
-    for (auto attr_id: rhs) {
-        _attributes.insert (attr_id);
+    if (_base_valid && rhs._base_valid && _base == rhs._base) {
+        for (size_t w = 0; w < WINDOW_WORDS; w++) {
+            _window[w] |= rhs._window[w];
+        }
+        _sparse.insert (rhs._sparse.begin (), rhs._sparse.end ());
+    } else {
+        for (auto attr_id: rhs) {
+            add (attr_id);
+        }
     }
     _max_attr_id = (_max_attr_id > rhs._max_attr_id)
         ? _max_attr_id:rhs._max_attr_id;
@@ -52,7 +175,7 @@ void nas::attr_set_t::to_array (nas_attr_id_t attr_array[],
                                 size_t in_array_len) const
 {
     size_t count = 0;
-    for (auto attr_id: _attributes) {
+    for (auto attr_id: *this) {
         if (count >= in_array_len) break;
         attr_array [count++] = attr_id;
     }
@@ -62,9 +185,9 @@ void nas::attr_set_t::to_array (nas_attr_id_t** attr_ptr,
                                 size_t* out_array_len,
                                 mem_alloc_helper_t& mem_guard) const
 {
-    auto attr_array = mem_guard.alloc<nas_attr_id_t> (_attributes.size());
+    auto attr_array = mem_guard.alloc<nas_attr_id_t> (size());
     size_t count = 0;
-    for (auto attr_id: _attributes) {
+    for (auto attr_id: *this) {
         attr_array [count++] = attr_id;
     }
     *out_array_len = count;
@@ -73,12 +196,82 @@ void nas::attr_set_t::to_array (nas_attr_id_t** attr_ptr,
 
 /////////// npu_set_t implementation ///////////
 //
+constexpr size_t nas::npu_set_t::INLINE_WORDS;
+constexpr size_t nas::npu_set_t::INLINE_BITS;
+
+bool nas::npu_set_t::empty () const
+{
+    for (auto word: _mask) {
+        if (word != 0) return false;
+    }
+    return _overflow.empty ();
+}
+
+size_t nas::npu_set_t::size () const
+{
+    size_t count = _overflow.size ();
+    for (auto word: _mask) {
+        count += __builtin_popcountll (word);
+    }
+    return count;
+}
+
+size_t nas::npu_set_t::_next_bit (size_t bit) const
+{
+    for (size_t w = bit / 64; w < INLINE_WORDS; w++) {
+        uint64_t word = _mask[w];
+        if (w == bit / 64) word &= (~0ULL << (bit % 64));
+        if (word != 0) return w * 64 + __builtin_ctzll (word);
+    }
+    return INLINE_BITS;
+}
+
+/* Overflow NPUs below 0, then the inline mask, then overflow NPUs above it */
+nas::npu_set_t::const_iterator nas::npu_set_t::begin () const
+{
+    auto sit = _overflow.begin ();
+    if (sit != _overflow.end () && *sit < 0) {
+        return const_iterator (this, INLINE_BITS, sit);
+    }
+    return const_iterator (this, _next_bit (0), sit);
+}
+
+nas::npu_set_t::const_iterator& nas::npu_set_t::const_iterator::operator++ ()
+{
+    if (_bit < INLINE_BITS) {
+        _bit = _set->_next_bit (_bit + 1);
+        return *this;
+    }
+    bool below = (*_sit < 0);
+    ++_sit;
+    if (below && (_sit == _set->_overflow.end () || *_sit >= 0)) {
+        _bit = _set->_next_bit (0);
+    }
+    return *this;
+}
+
+bool nas::npu_set_t::operator== (const nas::npu_set_t& rhs) const
+{
+    for (size_t w = 0; w < INLINE_WORDS; w++) {
+        if (_mask[w] != rhs._mask[w]) return false;
+    }
+    return _overflow == rhs._overflow;
+}
+
 void nas::npu_set_t::compare (const nas::npu_set_t& second,
                               nas::npu_set_t& only_mine,
                               nas::npu_set_t& only_second,
                               nas::npu_set_t& in_both) const
 {
-    for (auto npu_id: second) {
+    for (size_t w = 0; w < INLINE_WORDS; w++) {
+        only_mine._mask[w] |= (_mask[w] & ~second._mask[w]);
+        only_second._mask[w] |= (second._mask[w] & ~_mask[w]);
+        in_both._mask[w] |= (_mask[w] & second._mask[w]);
+    }
+
+    if (_overflow.empty () && second._overflow.empty ()) return;
+
+    for (auto npu_id: second._overflow) {
         if (!contains (npu_id)) {
             only_second.add (npu_id);
         } else {
@@ -86,7 +279,7 @@ void nas::npu_set_t::compare (const nas::npu_set_t& second,
         }
     }
 
-    for (auto npu_id: _npus) {
+    for (auto npu_id: _overflow) {
         if (!second.contains (npu_id)) {
             only_mine.add (npu_id);
         }
@@ -96,52 +289,178 @@ void nas::npu_set_t::compare (const nas::npu_set_t& second,
 void nas::npu_set_t::dump (std::string& str) const
 {
     str += "NPUs: ";
-    for (auto npu_id: _npus) {
+    for (auto npu_id: *this) {
         str += (std::to_string (npu_id) + ", ");
     }
 }
 
 /////////// id_generator_t implementation ///////////
 //
+constexpr size_t nas::id_generator_t::NPOS;
+constexpr uint32_t nas::id_generator_t::SNAPSHOT_MAGIC;
+constexpr uint16_t nas::id_generator_t::SNAPSHOT_VERSION;
+constexpr uint16_t nas::id_generator_t::SNAPSHOT_F_RLE;
+
+static inline uint64_t _id_word_mask (size_t bit, size_t len)
+{
+    return ((len >= 64) ? ~0ULL : ((1ULL << len) - 1)) << bit;
+}
+
 nas::id_generator_t::id_generator_t (size_t max_ids)
             :_max_ids (max_ids+1)
 {
-    _id_bitmap = std_bitmap_create_array (_max_ids);
-    if (!_id_bitmap) {
-        throw std::bad_alloc{};
+    size_t bits = _max_ids;
+    do {
+        _levels.emplace_back ((bits + 63) / 64, 0);
+        bits = (bits + 63) / 64;
+    } while (bits > 1);
+
+    // ID 0 is never handed out
+    _mark (1, max_ids, true);
+}
+
+size_t nas::id_generator_t::_find_free (size_t pos) const noexcept
+{
+    // Climb until a level has a free bit at or after pos
+    size_t level = 0;
+    size_t bit;
+    for (;; level++) {
+        size_t word = pos / 64;
+        if (level == _levels.size () || word >= _levels[level].size ()) {
+            return NPOS;
+        }
+        uint64_t w = _levels[level][word] & (~0ULL << (pos % 64));
+        if (w != 0) {
+            bit = word * 64 + __builtin_ctzll (w);
+            break;
+        }
+        pos = word + 1;
+    }
+    // Descend taking the first free bit of each word below
+    while (level > 0) {
+        level--;
+        bit = bit * 64 + __builtin_ctzll (_levels[level][bit]);
+    }
+    return bit;
+}
+
+size_t nas::id_generator_t::_find_used (size_t pos, size_t limit) const noexcept
+{
+    const auto& bitmap = _levels[0];
+    while (pos < limit) {
+        uint64_t w = ~bitmap[pos / 64] & (~0ULL << (pos % 64));
+        if (w != 0) {
+            return std::min (limit, (pos & ~(size_t)63) + __builtin_ctzll (w));
+        }
+        pos = (pos & ~(size_t)63) + 64;
+    }
+    return limit;
+}
+
+void nas::id_generator_t::_mark_word (size_t word, uint64_t mask, bool free) noexcept
+{
+    uint64_t& w = _levels[0][word];
+    uint64_t old = w;
+    if (free) {
+        w |= mask;
+        _free += __builtin_popcountll (w & ~old);
+    } else {
+        w &= ~mask;
+        _free -= __builtin_popcountll (old & ~w);
+    }
+
+    // Propagate empty/non-empty transitions up the summary levels
+    uint64_t cur = w;
+    for (size_t level = 1; level < _levels.size (); level++) {
+        if ((old != 0) == (cur != 0)) break;
+        uint64_t& up = _levels[level][word / 64];
+        old = up;
+        if (cur != 0) up |= (1ULL << (word % 64));
+        else up &= ~(1ULL << (word % 64));
+        cur = up;
+        word /= 64;
+    }
+}
+
+void nas::id_generator_t::_mark (size_t pos, size_t len, bool free) noexcept
+{
+    while (len > 0) {
+        size_t chunk = std::min (len, 64 - pos % 64);
+        _mark_word (pos / 64, _id_word_mask (pos % 64, chunk), free);
+        pos += chunk;
+        len -= chunk;
     }
 }
 
 nas_obj_id_t nas::id_generator_t::alloc_id ()
 {
-    int freepos;
-    if (_pos < _max_ids) {
-        if ((freepos = std_find_first_bit(_id_bitmap, _max_ids, _pos)) != -1) {
-            if (freepos < (int) _max_ids) {
-                _pos = freepos;
-                STD_BIT_ARRAY_CLR ((uint8_t*)_id_bitmap, _pos);
-                return _pos++;
-            }
+    size_t id = _find_free (_pos);
+    if (id == NPOS) {
+        id = _find_free (1);
+    }
+    if (id == NPOS) {
+        throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No more free IDs"};
+    }
+    _mark_word (id / 64, 1ULL << (id % 64), false);
+    _pos = id + 1;
+    return id;
+}
+
+void nas::id_generator_t::alloc_ids (size_t count, std::vector<nas_obj_id_t>& ids)
+{
+    if (count > _free) {
+        throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No more free IDs"};
+    }
+    ids.reserve (ids.size () + count);
+
+    // Take the free IDs of a bitmap word at a time
+    while (count > 0) {
+        size_t id = _find_free (_pos);
+        if (id == NPOS) {
+            id = _find_free (1);
+        }
+        size_t word = id / 64;
+        uint64_t avail = _levels[0][word] & (~0ULL << (id % 64));
+        uint64_t taken = 0;
+        for (; avail != 0 && count > 0; count--) {
+            uint64_t low = avail & (~avail + 1);
+            ids.push_back (word * 64 + __builtin_ctzll (avail));
+            taken |= low;
+            avail &= ~low;
         }
+        _mark_word (word, taken, false);
+        _pos = ids.back () + 1;
     }
-    _pos = 1;
-    if ((freepos = std_find_first_bit(_id_bitmap, _max_ids, _pos)) != -1) {
-        if (freepos < (int) _max_ids) {
-            _pos = freepos;
-            STD_BIT_ARRAY_CLR ((uint8_t*)_id_bitmap, _pos);
-            return _pos++;
+}
+
+nas_obj_id_t nas::id_generator_t::alloc_range (size_t len)
+{
+    if (len == 0 || len > _free) {
+        throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No free ID range"};
+    }
+    for (auto start: {_pos, (size_t)1}) {
+        size_t pos = start;
+        size_t id;
+        while ((id = _find_free (pos)) != NPOS && _max_ids - id >= len) {
+            size_t used = _find_used (id, id + len);
+            if (used == id + len) {
+                _mark (id, len, false);
+                _pos = id + len;
+                return id;
+            }
+            pos = used + 1;
         }
     }
-    throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No more free IDs"};
+    throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No free ID range"};
 }
 
 bool nas::id_generator_t::reserve_id (nas_obj_id_t id) noexcept
 {
-    if (id >= _max_ids) {
+    if (id == 0 || id >= _max_ids) {
         return false;
     }
-    if (STD_BIT_ARRAY_TEST ((uint8_t*)_id_bitmap, id)) {
-        STD_BIT_ARRAY_CLR ((uint8_t*)_id_bitmap, id);
+    if ((_levels[0][id / 64] >> (id % 64)) & 1) {
+        _mark_word (id / 64, 1ULL << (id % 64), false);
         return true;
     }
     return false;
@@ -149,23 +468,249 @@ bool nas::id_generator_t::reserve_id (nas_obj_id_t id) noexcept
 
 void nas::id_generator_t::release_id (nas_obj_id_t id) noexcept
 {
-    if (id < _max_ids) {
-        STD_BIT_ARRAY_SET ((uint8_t*)_id_bitmap, id);
+    if (id > 0 && id < _max_ids) {
+        _mark_word (id / 64, 1ULL << (id % 64), true);
     }
 }
 
-nas::id_generator_t::id_generator_t (nas::id_generator_t&& move) noexcept
-    :_max_ids (move._max_ids), _pos (move._pos)
+/* Snapshot RLE payload is a sequence of runs of identical bitmap words */
+struct __attribute__((packed)) id_gen_rle_run_t {
+    uint32_t count;
+    uint64_t word;
+};
+
+static uint32_t _id_gen_checksum (const uint8_t* data, size_t len)
 {
-    _id_bitmap = move._id_bitmap;
-    move._id_bitmap = NULL;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void nas::id_generator_t::_rebuild_summary () noexcept
+{
+    for (size_t level = 1; level < _levels.size (); level++) {
+        auto& below = _levels[level - 1];
+        auto& cur = _levels[level];
+        std::fill (cur.begin (), cur.end (), 0);
+        for (size_t w = 0; w < below.size (); w++) {
+            if (below[w] != 0) cur[w / 64] |= (1ULL << (w % 64));
+        }
+    }
+}
+
+void nas::id_generator_t::snapshot (std::vector<uint8_t>& blob, bool rle) const
+{
+    const auto& bitmap = _levels[0];
+    snapshot_hdr_t hdr {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, 0, _max_ids, _free, 0, 0};
+
+    blob.clear ();
+    if (!rle) {
+        hdr.payload_len = bitmap.size () * sizeof (uint64_t);
+        blob.resize (sizeof (hdr) + hdr.payload_len);
+        memcpy (&blob[sizeof (hdr)], bitmap.data (), hdr.payload_len);
+    } else {
+        hdr.flags = SNAPSHOT_F_RLE;
+        blob.resize (sizeof (hdr));
+        for (size_t w = 0; w < bitmap.size (); ) {
+            id_gen_rle_run_t run {1, bitmap[w]};
+            while (w + run.count < bitmap.size () && bitmap[w + run.count] == run.word &&
+                   run.count < UINT32_MAX) {
+                run.count++;
+            }
+            w += run.count;
+            auto p = reinterpret_cast<const uint8_t*> (&run);
+            blob.insert (blob.end (), p, p + sizeof (run));
+        }
+        hdr.payload_len = blob.size () - sizeof (hdr);
+    }
+    hdr.checksum = _id_gen_checksum (blob.data () + sizeof (hdr), hdr.payload_len);
+    memcpy (blob.data (), &hdr, sizeof (hdr));
+}
+
+void nas::id_generator_t::restore (const void* blob, size_t len)
+{
+    const char* fn = __PRETTY_FUNCTION__;
+    auto bad_snapshot = [fn] (const char* why) {
+        return nas::base_exception {NAS_BASE_E_PARAM, fn, why};
+    };
+    auto data = static_cast<const uint8_t*> (blob);
+    snapshot_hdr_t hdr;
+    if (data == nullptr || len < sizeof (hdr)) throw bad_snapshot ("Snapshot truncated");
+    memcpy (&hdr, data, sizeof (hdr));
+    if (hdr.magic != SNAPSHOT_MAGIC || hdr.version != SNAPSHOT_VERSION) {
+        throw bad_snapshot ("Not an ID generator snapshot");
+    }
+    if (hdr.max_ids != _max_ids) throw bad_snapshot ("Snapshot of a different ID space");
+    if (hdr.payload_len != len - sizeof (hdr)) throw bad_snapshot ("Snapshot truncated");
+    const uint8_t* payload = data + sizeof (hdr);
+    if (_id_gen_checksum (payload, hdr.payload_len) != hdr.checksum) {
+        throw bad_snapshot ("Snapshot checksum mismatch");
+    }
+
+    size_t words = _levels[0].size ();
+    std::vector<uint64_t> bitmap;
+    if (!(hdr.flags & SNAPSHOT_F_RLE)) {
+        if (hdr.payload_len != words * sizeof (uint64_t)) throw bad_snapshot ("Snapshot size mismatch");
+        bitmap.resize (words);
+        memcpy (bitmap.data (), payload, hdr.payload_len);
+    } else {
+        if (hdr.payload_len % sizeof (id_gen_rle_run_t) != 0) throw bad_snapshot ("Snapshot size mismatch");
+        bitmap.reserve (words);
+        for (size_t off = 0; off < hdr.payload_len; off += sizeof (id_gen_rle_run_t)) {
+            id_gen_rle_run_t run;
+            memcpy (&run, payload + off, sizeof (run));
+            if (run.count > words - bitmap.size ()) throw bad_snapshot ("Snapshot size mismatch");
+            bitmap.insert (bitmap.end (), run.count, run.word);
+        }
+        if (bitmap.size () != words) throw bad_snapshot ("Snapshot size mismatch");
+    }
+
+    // ID 0 and the bits past the last ID are never free
+    size_t tail = _max_ids % 64;
+    if ((bitmap[0] & 1) || (tail != 0 && (bitmap[words - 1] >> tail) != 0)) {
+        throw bad_snapshot ("Snapshot has IDs out of range");
+    }
+    size_t free = 0;
+    for (auto w: bitmap) free += __builtin_popcountll (w);
+    if (free != hdr.free) throw bad_snapshot ("Snapshot free count mismatch");
+
+    _levels[0].swap (bitmap);
+    _free = free;
+    _pos = 1;
+    _rebuild_summary ();
 }
 
+nas::id_generator_t::id_generator_t (nas::id_generator_t&& move) noexcept
+    :_max_ids (move._max_ids), _pos (move._pos), _free (move._free),
+     _levels (std::move (move._levels))
+{
+    move._free = 0;
+}
 
 nas::id_generator_t& nas::id_generator_t::operator= (nas::id_generator_t&& move) noexcept
 {
+    _max_ids = move._max_ids;
     _pos = move._pos;
-    _id_bitmap = move._id_bitmap;
-    move._id_bitmap = NULL;
+    _free = move._free;
+    _levels = std::move (move._levels);
+    move._free = 0;
     return *this;
 }
+
+/////////// concurrent_id_generator_t implementation ///////////
+//
+constexpr size_t nas::concurrent_id_generator_t::HINT_SLOTS;
+
+nas::concurrent_id_generator_t::concurrent_id_generator_t (size_t max_ids)
+    : _max_ids (max_ids+1), _words ((_max_ids + 63) / 64),
+      _summary_words ((_words + 63) / 64),
+      _bitmap (new std::atomic<uint64_t>[_words]),
+      _summary (new std::atomic<uint64_t>[_summary_words])
+{
+    for (size_t w = 0; w < _words; w++) {
+        size_t first = w * 64;
+        size_t len = std::min ((size_t) 64, _max_ids - first);
+        uint64_t bits = (len == 64) ? ~0ULL : ((1ULL << len) - 1);
+        // ID 0 is never handed out
+        if (w == 0) bits &= ~1ULL;
+        _bitmap[w].store (bits, std::memory_order_relaxed);
+    }
+    for (size_t s = 0; s < _summary_words; s++) {
+        uint64_t bits = 0;
+        for (size_t w = s * 64; w < std::min (_words, s * 64 + 64); w++) {
+            if (_bitmap[w].load (std::memory_order_relaxed) != 0) bits |= (1ULL << (w % 64));
+        }
+        _summary[s].store (bits, std::memory_order_relaxed);
+    }
+    for (size_t h = 0; h < HINT_SLOTS; h++) {
+        _hints[h].word.store (h * _words / HINT_SLOTS, std::memory_order_relaxed);
+    }
+}
+
+size_t nas::concurrent_id_generator_t::_hint_slot () noexcept
+{
+    static std::atomic<size_t> next_slot {0};
+    thread_local size_t slot = next_slot.fetch_add (1, std::memory_order_relaxed) % HINT_SLOTS;
+    return slot;
+}
+
+void nas::concurrent_id_generator_t::_word_emptied (size_t word) noexcept
+{
+    uint64_t bit = 1ULL << (word % 64);
+    _summary[word / 64].fetch_and (~bit);
+    // A release may have refilled the word before the summary bit was cleared
+    if (_bitmap[word].load () != 0) {
+        _summary[word / 64].fetch_or (bit);
+    }
+}
+
+size_t nas::concurrent_id_generator_t::free_count () const noexcept
+{
+    size_t count = 0;
+    for (size_t w = 0; w < _words; w++) {
+        count += __builtin_popcountll (_bitmap[w].load (std::memory_order_relaxed));
+    }
+    return count;
+}
+
+nas_obj_id_t nas::concurrent_id_generator_t::alloc_id ()
+{
+    hint_t& hint = _hints[_hint_slot ()];
+    size_t start = hint.word.load (std::memory_order_relaxed);
+
+    // One pass over the summary from the hint, the first summary word is
+    // visited again at the end for the words before the hint
+    for (size_t n = 0; n <= _summary_words; n++) {
+        size_t s = (start / 64 + n) % _summary_words;
+        uint64_t sum = _summary[s].load (std::memory_order_acquire);
+        if (n == 0) sum &= (~0ULL << (start % 64));
+
+        for (; sum != 0; sum &= sum - 1) {
+            size_t word = s * 64 + __builtin_ctzll (sum);
+            uint64_t w = _bitmap[word].load (std::memory_order_relaxed);
+            while (w != 0) {
+                uint64_t bit = w & (~w + 1);
+                uint64_t old = _bitmap[word].fetch_and (~bit);
+                if (old & bit) {
+                    if (old == bit) _word_emptied (word);
+                    hint.word.store (word, std::memory_order_relaxed);
+                    return word * 64 + __builtin_ctzll (bit);
+                }
+                w = old & ~bit;
+            }
+        }
+    }
+    throw nas::base_exception {NAS_BASE_E_FULL, __PRETTY_FUNCTION__, "No more free IDs"};
+}
+
+bool nas::concurrent_id_generator_t::reserve_id (nas_obj_id_t id) noexcept
+{
+    if (id == 0 || id >= _max_ids) {
+        return false;
+    }
+    uint64_t bit = 1ULL << (id % 64);
+    uint64_t old = _bitmap[id / 64].fetch_and (~bit);
+    if (!(old & bit)) {
+        return false;
+    }
+    if (old == bit) _word_emptied (id / 64);
+    return true;
+}
+
+void nas::concurrent_id_generator_t::release_id (nas_obj_id_t id) noexcept
+{
+    if (id == 0 || id >= _max_ids) {
+        return;
+    }
+    uint64_t bit = 1ULL << (id % 64);
+    uint64_t old = _bitmap[id / 64].fetch_or (bit);
+    if (old & bit) {
+        return;
+    }
+    if (old == 0) {
+        size_t word = id / 64;
+        _summary[word / 64].fetch_or (1ULL << (word % 64));
+    }
+}
@@ -23,28 +23,255 @@
 #include "std_utils.h"
 #include "ds_common_types.h"
 #include "std_mutex_lock.h"
+#include "nas_com_bridge_utils.h"
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+/*
+ * Map of 1D bridge name (VN) to untagged vlan_id.
+ *
+ * Open addressing hash table read without locks: writers hold
+ * bridge_to_vlan_id_map_mutex and bump br_map_seq to an odd value while they
+ * change slots in place, readers retry a lookup that overlapped such a change.
+ * When the table grows the new table is fully built before it is published,
+ * the previous tables are kept (their total size is below the current one)
+ * so a reader never touches freed memory.
+ */
+static const size_t BR_NAME_WORDS = (HAL_IF_NAME_SZ + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+static const size_t BR_MAP_MIN_SLOTS = 64;
+
+enum br_slot_state_t : uint32_t {
+    BR_SLOT_EMPTY = 0,
+    BR_SLOT_USED,
+    BR_SLOT_DELETED,
+};
 
-//map to maintain parent_bridge_port index (VN) to vlan_id
-static auto  bridge_to_vlan_id_map = new std::unordered_map<std::string ,hal_vlan_id_t>;
-static hal_vlan_id_t reserved_untagged_vlanid  = 0;
+struct br_slot_t {
+    std::atomic<uint32_t> state;
+    std::atomic<hal_vlan_id_t> vlan_id;
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> name[BR_NAME_WORDS];
+};
 
+struct br_table_t {
+    size_t mask;
+    size_t used = 0;
+    size_t deleted = 0;
+    std::unique_ptr<br_slot_t[]> slots;
+
+    br_table_t(size_t n) : mask(n - 1), slots(new br_slot_t[n]()) {}
+};
+
+/* Bridge name zero padded to whole words */
+struct br_key_t {
+    uint64_t name[BR_NAME_WORDS];
+    size_t words;
+    uint64_t hash;
+};
+
+static std::atomic<br_table_t *> bridge_to_vlan_id_map{new br_table_t(BR_MAP_MIN_SLOTS)};
+static auto bridge_to_vlan_id_map_old = new std::vector<std::unique_ptr<br_table_t>>;
+static std::atomic<uint32_t> br_map_seq{0};
+
+/* Reverse index of untagged vlan_id to bridges, only used under the mutex */
+static auto vlan_id_to_bridge_map = new std::unordered_map<hal_vlan_id_t, std::set<std::string>>;
+
+static std::atomic<hal_vlan_id_t> reserved_untagged_vlanid{0};
 
 static std_mutex_lock_create_static_init_fast(bridge_to_vlan_id_map_mutex);
 
+static bool _mk_key(const char *name, br_key_t &k) {
+    size_t len = strnlen(name, HAL_IF_NAME_SZ);
+    if (len >= HAL_IF_NAME_SZ) return false;
+
+    k.words = len / sizeof(uint64_t) + 1;
+    memset(k.name, 0, k.words * sizeof(uint64_t));
+    memcpy(k.name, name, len);
+
+    /* FNV-1a */
+    k.hash = 0xcbf29ce484222325ULL;
+    for (size_t ix = 0; ix < len; ++ix) {
+        k.hash ^= (uint8_t)name[ix];
+        k.hash *= 0x100000001b3ULL;
+    }
+    return true;
+}
+
+static bool _slot_match(const br_slot_t &slot, const br_key_t &k) {
+    if (slot.hash.load(std::memory_order_relaxed) != k.hash) return false;
+    for (size_t ix = 0; ix < k.words; ++ix) {
+        if (slot.name[ix].load(std::memory_order_relaxed) != k.name[ix]) return false;
+    }
+    return true;
+}
+
+static br_slot_t *_find(br_table_t *t, const br_key_t &k) {
+    for (size_t probe = 0; probe <= t->mask; ++probe) {
+        br_slot_t &slot = t->slots[(k.hash + probe) & t->mask];
+        uint32_t state = slot.state.load(std::memory_order_relaxed);
+        if (state == BR_SLOT_EMPTY) return nullptr;
+        if (state == BR_SLOT_USED && _slot_match(slot, k)) return &slot;
+    }
+    return nullptr;
+}
+
+static bool _lookup(const br_key_t &k, hal_vlan_id_t &vlan_id) {
+    while (true) {
+        uint32_t seq = br_map_seq.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+
+        br_slot_t *slot = _find(bridge_to_vlan_id_map.load(std::memory_order_acquire), k);
+        hal_vlan_id_t vid = (slot != nullptr) ? slot->vlan_id.load(std::memory_order_relaxed) : 0;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (br_map_seq.load(std::memory_order_relaxed) == seq) {
+            vlan_id = vid;
+            return slot != nullptr;
+        }
+    }
+}
+
+/* Writer side - called with bridge_to_vlan_id_map_mutex held */
+static void _write_begin() {
+    br_map_seq.store(br_map_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void _write_end() {
+    br_map_seq.store(br_map_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+static void _slot_set(br_table_t *t, const br_key_t &k, hal_vlan_id_t vlan_id) {
+    size_t ix = k.hash & t->mask;
+    while (t->slots[ix].state.load(std::memory_order_relaxed) == BR_SLOT_USED) {
+        ix = (ix + 1) & t->mask;
+    }
+    br_slot_t &slot = t->slots[ix];
+    if (slot.state.load(std::memory_order_relaxed) == BR_SLOT_DELETED) --t->deleted;
+    for (size_t w = 0; w < BR_NAME_WORDS; ++w) {
+        slot.name[w].store(w < k.words ? k.name[w] : 0, std::memory_order_relaxed);
+    }
+    slot.hash.store(k.hash, std::memory_order_relaxed);
+    slot.vlan_id.store(vlan_id, std::memory_order_relaxed);
+    slot.state.store(BR_SLOT_USED, std::memory_order_relaxed);
+    ++t->used;
+}
+
+static void _slot_key(const br_slot_t &slot, br_key_t &k) {
+    k.words = BR_NAME_WORDS;
+    for (size_t w = 0; w < BR_NAME_WORDS; ++w) {
+        k.name[w] = slot.name[w].load(std::memory_order_relaxed);
+    }
+    k.hash = slot.hash.load(std::memory_order_relaxed);
+}
+
+/* Copy the live entries of "from" into "to" */
+static void _rehash(const br_table_t *from, br_table_t *to) {
+    br_key_t k;
+    for (size_t ix = 0; ix <= from->mask; ++ix) {
+        const br_slot_t &slot = from->slots[ix];
+        if (slot.state.load(std::memory_order_relaxed) != BR_SLOT_USED) continue;
+        _slot_key(slot, k);
+        _slot_set(to, k, slot.vlan_id.load(std::memory_order_relaxed));
+    }
+}
+
+/* Make room for n more entries, keeping the load (including deleted slots) under 3/4 */
+static void _reserve(br_table_t *t, size_t n) {
+    size_t slots = t->mask + 1;
+    if ((t->used + t->deleted + n) * 4 <= slots * 3) return;
+
+    if ((t->used + n) * 2 > slots) {
+        while ((t->used + n) * 2 > slots) slots *= 2;
+        std::unique_ptr<br_table_t> grown(new br_table_t(slots));
+        _rehash(t, grown.get());
+        bridge_to_vlan_id_map.store(grown.release(), std::memory_order_release);
+        bridge_to_vlan_id_map_old->emplace_back(t);
+        return;
+    }
+
+    /* Mostly deleted slots - rehash in place */
+    br_table_t live(slots);
+    _rehash(t, &live);
+    _write_begin();
+    for (size_t ix = 0; ix < slots; ++ix) {
+        br_slot_t &slot = t->slots[ix];
+        br_slot_t &src = live.slots[ix];
+        for (size_t w = 0; w < BR_NAME_WORDS; ++w) {
+            slot.name[w].store(src.name[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        slot.hash.store(src.hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slot.vlan_id.store(src.vlan_id.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slot.state.store(src.state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    t->used = live.used;
+    t->deleted = 0;
+    _write_end();
+}
+
+static t_std_error _add_locked(const char *name, hal_vlan_id_t vlan_id) {
+    br_key_t k;
+    if (!_mk_key(name, k)) return STD_ERR(INTERFACE,PARAM,0);
+
+    br_table_t *t = bridge_to_vlan_id_map.load(std::memory_order_relaxed);
+    br_slot_t *slot = _find(t, k);
+    if (slot != nullptr) {
+        /*  already present */
+        EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  already present for 1d bridge %s and %d ",
+                                     name, slot->vlan_id.load(std::memory_order_relaxed));
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+    _reserve(t, 1);
+    t = bridge_to_vlan_id_map.load(std::memory_order_relaxed);
+    _write_begin();
+    _slot_set(t, k, vlan_id);
+    _write_end();
+    (*vlan_id_to_bridge_map)[vlan_id].insert(name);
+    return STD_ERR_OK;
+}
+
+static t_std_error _del_locked(const char *name) {
+    br_key_t k;
+    if (!_mk_key(name, k)) return STD_ERR(INTERFACE,PARAM,0);
+
+    br_table_t *t = bridge_to_vlan_id_map.load(std::memory_order_relaxed);
+    br_slot_t *slot = _find(t, k);
+    if (slot == nullptr) {
+        EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  not present for 1d bridge %s ", name);
+       /*  not present  */
+       return STD_ERR(INTERFACE,PARAM,0);
+    }
+    hal_vlan_id_t vlan_id = slot->vlan_id.load(std::memory_order_relaxed);
+    _write_begin();
+    slot->state.store(BR_SLOT_DELETED, std::memory_order_relaxed);
+    _write_end();
+    --t->used;
+    ++t->deleted;
+
+    auto it = vlan_id_to_bridge_map->find(vlan_id);
+    if (it != vlan_id_to_bridge_map->end()) {
+        it->second.erase(name);
+        if (it->second.empty()) vlan_id_to_bridge_map->erase(it);
+    }
+    return STD_ERR_OK;
+}
+
 void nas_com_get_1d_br_reserved_vid(hal_vlan_id_t *vlan_id) {
-   *(vlan_id) = reserved_untagged_vlanid;
+   *(vlan_id) = reserved_untagged_vlanid.load(std::memory_order_relaxed);
 }
 
 t_std_error nas_com_get_1d_br_untag_vid(const char *name, hal_vlan_id_t &vlan_id) {
 
     if (name == NULL) return STD_ERR(INTERFACE,PARAM,0);
 
-    std::string br_name(name);
-    std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
-    auto it = bridge_to_vlan_id_map->find(std::string(br_name));
-    if (it == bridge_to_vlan_id_map->end()) {
+    br_key_t k;
+    if (!_mk_key(name, k) || !_lookup(k, vlan_id)) {
        /* If not in the map it is not an attached case, but send the default untagged VLAN id for 1D bridge  */
        nas_com_get_1d_br_reserved_vid(&vlan_id);
        if (vlan_id == 0) {
@@ -52,11 +279,10 @@ t_std_error nas_com_get_1d_br_untag_vid(const char *name, hal_vlan_id_t &vlan_id
            return STD_ERR(INTERFACE,PARAM,0);
 
        }
-       EV_LOGGING(NAS_COM ,INFO, "BRIDGE-UTIL", "Untagged RESERVED VLAN id for 1d bridge %s is %d ", name, vlan_id);
+       EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged RESERVED VLAN id for 1d bridge %s is %d ", name, vlan_id);
        return STD_ERR_OK;
     }
-    vlan_id = it->second;
-    EV_LOGGING(NAS_COM ,INFO, "BRIDGE-UTIL", "Untagged VLAN id for 1d bridge %s is %d ", name, vlan_id);
+    EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id for 1d bridge %s is %d ", name, vlan_id);
     return STD_ERR_OK;
 }
 
@@ -66,41 +292,78 @@ t_std_error nas_com_add_1d_br_untag_vid(const char * name, hal_vlan_id_t vlan_id
     EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  map add for 1d bridge  %s and %d ",
                                  name, vlan_id);
 
-    std::string br_name(name);
     std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
-    auto it =  bridge_to_vlan_id_map->find(br_name);
-    if (it == bridge_to_vlan_id_map->end()) {
-        bridge_to_vlan_id_map->insert(make_pair(br_name,vlan_id));
-        return STD_ERR_OK;
-       /*  already present */
-    }
-    EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  already present for 1d bridge %s and %d ",
-                                 it->first.c_str(), it->second);
-    return STD_ERR(INTERFACE,PARAM,0);
+    return _add_locked(name, vlan_id);
 }
 
 t_std_error nas_com_del_1d_br_untag_vid(const char * name) {
 
     if (name == NULL) return STD_ERR(INTERFACE,PARAM,0);
 
-    std::string br_name(name);
     EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  map delete for 1d bridge  %s ", name);
     std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
-    auto it =  bridge_to_vlan_id_map->find(br_name);
-    if (it == bridge_to_vlan_id_map->end()) {
-        EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  not present for 1d bridge %s ", name);
-       /*  not present  */
-       return STD_ERR(INTERFACE,PARAM,0);
+    return _del_locked(name);
+}
+
+t_std_error nas_com_get_1d_br_by_untag_vid(hal_vlan_id_t vlan_id, std::vector<std::string> &br_names) {
+
+    std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
+    auto it = vlan_id_to_bridge_map->find(vlan_id);
+    if (it == vlan_id_to_bridge_map->end()) {
+        return STD_ERR(INTERFACE,PARAM,0);
     }
-    bridge_to_vlan_id_map->erase(it);
+    br_names.insert(br_names.end(), it->second.begin(), it->second.end());
     return STD_ERR_OK;
 }
 
-t_std_error nas_com_set_1d_br_reserved_vid(hal_vlan_id_t vlan_id) {
+t_std_error nas_com_add_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count) {
+
+    if (entries == NULL && count > 0) return STD_ERR(INTERFACE,PARAM,0);
+    EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  map bulk add of %zu 1d bridges", count);
+
+    t_std_error rc = STD_ERR_OK;
+    std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
+    _reserve(bridge_to_vlan_id_map.load(std::memory_order_relaxed), count);
+    for (size_t ix = 0; ix < count; ++ix) {
+        nas_com_br_untag_vid_t &e = entries[ix];
+        e.rc = (e.br_name == NULL) ? STD_ERR(INTERFACE,PARAM,0) : _add_locked(e.br_name, e.vlan_id);
+        if (e.rc != STD_ERR_OK) rc = STD_ERR(INTERFACE,FAIL,0);
+    }
+    return rc;
+}
+
+t_std_error nas_com_del_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count) {
+
+    if (entries == NULL && count > 0) return STD_ERR(INTERFACE,PARAM,0);
+    EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Untagged VLAN id  map bulk delete of %zu 1d bridges", count);
 
+    t_std_error rc = STD_ERR_OK;
     std_mutex_simple_lock_guard lock(&bridge_to_vlan_id_map_mutex);
-    reserved_untagged_vlanid = vlan_id;
+    for (size_t ix = 0; ix < count; ++ix) {
+        nas_com_br_untag_vid_t &e = entries[ix];
+        e.rc = (e.br_name == NULL) ? STD_ERR(INTERFACE,PARAM,0) : _del_locked(e.br_name);
+        if (e.rc != STD_ERR_OK) rc = STD_ERR(INTERFACE,FAIL,0);
+    }
+    return rc;
+}
+
+t_std_error nas_com_get_1d_br_untag_vid_bulk(nas_com_br_untag_vid_t *entries, size_t count) {
+
+    if (entries == NULL && count > 0) return STD_ERR(INTERFACE,PARAM,0);
+
+    t_std_error rc = STD_ERR_OK;
+    for (size_t ix = 0; ix < count; ++ix) {
+        nas_com_br_untag_vid_t &e = entries[ix];
+        e.rc = (e.br_name == NULL) ? STD_ERR(INTERFACE,PARAM,0) :
+                                     nas_com_get_1d_br_untag_vid(e.br_name, e.vlan_id);
+        if (e.rc != STD_ERR_OK) rc = STD_ERR(INTERFACE,FAIL,0);
+    }
+    return rc;
+}
+
+t_std_error nas_com_set_1d_br_reserved_vid(hal_vlan_id_t vlan_id) {
+
+    reserved_untagged_vlanid.store(vlan_id, std::memory_order_relaxed);
     EV_LOGGING(NAS_COM ,DEBUG, "BRIDGE-UTIL", "Reserved Untagged VLAN id for 1d bridge set to  %d ", vlan_id);
     return STD_ERR_OK;
 }
-
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * filename: nas_if_db_replay.cpp
+ **/
+
+/*
+ * Replays an interface DB trace (see hal_if_trace.h) against the interface DB.
+ * Thread 0 replays every call of the trace in order, any additional threads
+ * replay only the lookups of the trace concurrently with it. Throughput and
+ * latency percentiles are reported per operation, the time spent clearing the
+ * DB between loops is not counted.
+ */
+
+#include "hal_if_mapping.h"
+#include "hal_if_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct trace_op_t {
+    hal_if_trace_rec_t rec;
+    std::string name;
+    std::string data;
+};
+
+/*
+ * Log-linear latency histogram: values below LAT_SUB_BUCKETS get a bucket each,
+ * above that every power of two is split in LAT_SUB_BUCKETS buckets, so a
+ * percentile is off by at most 1/LAT_SUB_BUCKETS of its value. Recording is
+ * a couple of instructions and never allocates.
+ */
+static const unsigned LAT_SUB_BITS = 4;
+static const unsigned LAT_SUB_BUCKETS = 1 << LAT_SUB_BITS;
+static const unsigned LAT_BUCKETS = (64 - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS;
+
+static inline unsigned _lat_bucket(uint64_t ns) {
+    if (ns < LAT_SUB_BUCKETS) return (unsigned)ns;
+    unsigned msb = 63 - __builtin_clzll(ns);
+    unsigned sub = (unsigned)(ns >> (msb - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1);
+    return (msb - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS + sub;
+}
+
+/* Smallest latency recorded in a bucket */
+static inline uint64_t _lat_bucket_min(unsigned bucket) {
+    if (bucket < LAT_SUB_BUCKETS) return bucket;
+    unsigned msb = bucket / LAT_SUB_BUCKETS + LAT_SUB_BITS - 1;
+    uint64_t sub = bucket % LAT_SUB_BUCKETS;
+    return (LAT_SUB_BUCKETS + sub) << (msb - LAT_SUB_BITS);
+}
+
+struct op_stats_t {
+    uint64_t lat_ns[HAL_IF_TRACE_OP_MAX][LAT_BUCKETS] = {{0}};
+    size_t count[HAL_IF_TRACE_OP_MAX] = {0};
+    size_t errors[HAL_IF_TRACE_OP_MAX] = {0};
+};
+
+static const char *op_names[HAL_IF_TRACE_OP_MAX] = {
+    "", "reg", "dereg", "get", "get-next-ifindex", "upd-mac", "upd-desc", "upd-l3-info"
+};
+
+static bool _load_trace(const char *path, std::vector<trace_op_t> &ops) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    hal_if_trace_file_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != HAL_IF_TRACE_MAGIC ||
+        hdr.version != HAL_IF_TRACE_VERSION) {
+        fprintf(stderr, "%s is not an interface DB trace\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    trace_op_t op;
+    while (fread(&op.rec, sizeof(op.rec), 1, fp) == 1) {
+        op.name.assign(op.rec.name_len, '\0');
+        op.data.assign(op.rec.data_len, '\0');
+        if ((op.rec.name_len > 0 && fread(&op.name[0], op.rec.name_len, 1, fp) != 1) ||
+            (op.rec.data_len > 0 && fread(&op.data[0], op.rec.data_len, 1, fp) != 1)) {
+            fprintf(stderr, "Truncated record %zu in %s\n", ops.size(), path);
+            break;
+        }
+        if (op.rec.op == 0 || op.rec.op >= HAL_IF_TRACE_OP_MAX) {
+            fprintf(stderr, "Unknown operation %d in record %zu\n", op.rec.op, ops.size());
+            break;
+        }
+        ops.push_back(op);
+    }
+    fclose(fp);
+    return true;
+}
+
+static void _to_intf(const trace_op_t &op, interface_ctrl_t &intf) {
+    memset(&intf, 0, sizeof(intf));
+    const hal_if_trace_rec_t &r = op.rec;
+    intf.q_type = (intf_info_t)r.q_type;
+    intf.int_type = (nas_int_type_t)r.int_type;
+    intf.int_sub_type = r.int_sub_type;
+    intf.vrf_id = r.vrf_id;
+    intf.if_index = r.if_index;
+    intf.npu_id = r.npu_id;
+    intf.tap_id = r.tap_id;
+    intf.sub_interface = r.sub_interface;
+    memcpy(&intf.lag_id, r.ids, sizeof(r.ids));
+    intf.l3_intf_info.vrf_id = r.l3_vrf_id;
+    intf.l3_intf_info.if_index = r.l3_if_index;
+    memcpy(intf.if_name, op.name.data(), std::min(op.name.size(), sizeof(intf.if_name) - 1));
+}
+
+static t_std_error _run_op(const trace_op_t &op) {
+    interface_ctrl_t intf;
+    _to_intf(op, intf);
+    hal_ifindex_t next;
+
+    switch (op.rec.op) {
+    case HAL_IF_TRACE_OP_REG:
+        return dn_hal_if_register(HAL_INTF_OP_REG, &intf);
+    case HAL_IF_TRACE_OP_DEREG:
+        return dn_hal_if_register(HAL_INTF_OP_DEREG, &intf);
+    case HAL_IF_TRACE_OP_GET:
+        return dn_hal_get_interface_info(&intf);
+    case HAL_IF_TRACE_OP_GET_NEXT_IFINDEX:
+        return dn_hal_get_next_ifindex(intf.if_index == NAS_INVALID_IF_INDEX ? nullptr : &intf.if_index,
+                                       &next);
+    case HAL_IF_TRACE_OP_UPD_MAC:
+        return dn_hal_update_intf_mac(intf.if_index, op.data.c_str());
+    case HAL_IF_TRACE_OP_UPD_DESC:
+        return dn_hal_update_intf_desc(&intf, op.data.c_str());
+    case HAL_IF_TRACE_OP_UPD_L3_INFO:
+        return nas_cmn_update_router_intf_info(intf.vrf_id, intf.if_index, &intf.l3_intf_info);
+    default:
+        return STD_ERR(INTERFACE,PARAM,0);
+    }
+}
+
+static inline void _timed_op(const trace_op_t &op, op_stats_t &stats) {
+    auto start = std::chrono::steady_clock::now();
+    t_std_error rc = _run_op(op);
+    auto end = std::chrono::steady_clock::now();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    ++stats.lat_ns[op.rec.op][_lat_bucket(ns)];
+    ++stats.count[op.rec.op];
+    if (rc != STD_ERR_OK) ++stats.errors[op.rec.op];
+}
+
+static bool _collect_intf(const interface_ctrl_t *p, void *context) {
+    interface_ctrl_t intf = *p;
+    intf.desc = nullptr;
+    intf.q_type = HAL_INTF_INFO_FROM_IF;
+    static_cast<std::vector<interface_ctrl_t> *>(context)->push_back(intf);
+    return true;
+}
+
+/* Remove whatever the trace left registered so the next loop starts from the same state */
+static void _clear_db() {
+    std::vector<interface_ctrl_t> left;
+    dn_hal_walk_interfaces(_collect_intf, &left, nullptr);
+    for (auto &intf : left) {
+        dn_hal_if_register(HAL_INTF_OP_DEREG, &intf);
+    }
+}
+
+static void _report(const std::vector<op_stats_t> &stats, double secs) {
+    printf("%-18s %10s %8s %12s %10s %10s %10s\n", "op", "count", "errors", "ops/sec",
+           "p50(ns)", "p99(ns)", "p99.9(ns)");
+    for (int op = HAL_IF_TRACE_OP_REG; op < HAL_IF_TRACE_OP_MAX; ++op) {
+        std::vector<uint64_t> lat(LAT_BUCKETS, 0);
+        size_t count = 0;
+        size_t errors = 0;
+        for (auto &s : stats) {
+            for (unsigned b = 0; b < LAT_BUCKETS; ++b) lat[b] += s.lat_ns[op][b];
+            count += s.count[op];
+            errors += s.errors[op];
+        }
+        if (count == 0) continue;
+        auto pct = [&lat, count](double p) {
+            uint64_t rank = (uint64_t)(p * (count - 1)) + 1;
+            uint64_t seen = 0;
+            for (unsigned b = 0; b < LAT_BUCKETS; ++b) {
+                seen += lat[b];
+                if (seen >= rank) return _lat_bucket_min(b);
+            }
+            return _lat_bucket_min(LAT_BUCKETS - 1);
+        };
+        printf("%-18s %10zu %8zu %12.0f %10lu %10lu %10lu\n", op_names[op], count, errors,
+               count / secs, (unsigned long)pct(0.50), (unsigned long)pct(0.99),
+               (unsigned long)pct(0.999));
+    }
+}
+
+static void _usage(const char *prog) {
+    fprintf(stderr, "usage: %s <trace-file> [-t threads] [-l loops]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    size_t threads = 1;
+    size_t loops = 1;
+    int c;
+    while ((c = getopt(argc, argv, "t:l:h")) != -1) {
+        switch (c) {
+        case 't': threads = strtoul(optarg, nullptr, 0); break;
+        case 'l': loops = strtoul(optarg, nullptr, 0); break;
+        default: _usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc || threads == 0 || loops == 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    /* Never trace the replay itself */
+    unsetenv(HAL_IF_TRACE_ENV_VAR);
+
+    std::vector<trace_op_t> ops;
+    if (!_load_trace(argv[optind], ops)) return 1;
+
+    std::vector<trace_op_t> lookups;
+    for (auto &op : ops) {
+        if (op.rec.op == HAL_IF_TRACE_OP_GET || op.rec.op == HAL_IF_TRACE_OP_GET_NEXT_IFINDEX) {
+            lookups.push_back(op);
+        }
+    }
+    printf("Replaying %zu calls (%zu lookups) x %zu loops on %zu threads\n",
+           ops.size(), lookups.size(), loops, threads);
+
+    std::vector<op_stats_t> stats(threads);
+    std::atomic<bool> done{false};
+    std::atomic<bool> clearing{false};
+    std::vector<std::thread> readers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t ix = 1; ix < threads && !lookups.empty(); ++ix) {
+        readers.emplace_back([&, ix]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                for (auto &op : lookups) {
+                    if (clearing.load(std::memory_order_relaxed)) break;
+                    _timed_op(op, stats[ix]);
+                }
+                /* Readers sit out the clear between loops, it is not part of the run */
+                while (clearing.load(std::memory_order_relaxed)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::chrono::steady_clock::duration cleared{0};
+    for (size_t loop = 0; loop < loops; ++loop) {
+        for (auto &op : ops) _timed_op(op, stats[0]);
+        auto clear_start = std::chrono::steady_clock::now();
+        clearing = true;
+        _clear_db();
+        clearing = false;
+        cleared += std::chrono::steady_clock::now() - clear_start;
+    }
+    done = true;
+    for (auto &t : readers) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start -
+                                                cleared).count();
+
+    _report(stats, secs);
+    return 0;
+}
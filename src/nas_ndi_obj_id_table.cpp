@@ -26,6 +26,126 @@
 #include "event_log.h"
 #include "nas_com_log.h"
 #include <vector>
+#include <algorithm>
+#include <string.h>
+
+constexpr size_t nas::ndi_obj_id_table_t::INLINE_ENTRIES;
+
+nas::ndi_obj_id_table_t::ndi_obj_id_table_t (const ndi_obj_id_table_t& src)
+{
+    _copy (src);
+}
+
+nas::ndi_obj_id_table_t::ndi_obj_id_table_t (ndi_obj_id_table_t&& src) noexcept
+{
+    _move (src);
+}
+
+nas::ndi_obj_id_table_t& nas::ndi_obj_id_table_t::operator= (const ndi_obj_id_table_t& src)
+{
+    if (this != &src) {
+        _size = 0;
+        _copy (src);
+    }
+    return *this;
+}
+
+nas::ndi_obj_id_table_t& nas::ndi_obj_id_table_t::operator= (ndi_obj_id_table_t&& src) noexcept
+{
+    if (this != &src) {
+        if (_data != _inline) delete[] _data;
+        _data = _inline;
+        _capacity = INLINE_ENTRIES;
+        _move (src);
+    }
+    return *this;
+}
+
+void nas::ndi_obj_id_table_t::_copy (const ndi_obj_id_table_t& src)
+{
+    reserve (src._size);
+    std::copy (src.begin(), src.end(), _data);
+    _size = src._size;
+}
+
+/* Steal the heap array of src, or copy its inline entries */
+void nas::ndi_obj_id_table_t::_move (ndi_obj_id_table_t& src) noexcept
+{
+    if (src._data == src._inline) {
+        std::copy (src.begin(), src.end(), _inline);
+    } else {
+        _data = src._data;
+        _capacity = src._capacity;
+        src._data = src._inline;
+        src._capacity = INLINE_ENTRIES;
+    }
+    _size = src._size;
+    src._size = 0;
+}
+
+void nas::ndi_obj_id_table_t::reserve (size_t n)
+{
+    if (n <= _capacity) return;
+
+    value_type* data = new value_type[n];
+    std::copy (begin(), end(), data);
+    if (_data != _inline) delete[] _data;
+    _data = data;
+    _capacity = n;
+}
+
+ndi_obj_id_t& nas::ndi_obj_id_table_t::at (npu_id_t npu_id)
+{
+    iterator it = find (npu_id);
+    if (it == end()) {
+        throw std::out_of_range ("ndi_obj_id_table_t: NPU not in table");
+    }
+    return it->second;
+}
+
+std::pair<nas::ndi_obj_id_table_t::iterator, bool>
+nas::ndi_obj_id_table_t::_insert (npu_id_t npu_id, ndi_obj_id_t ndi_obj_id)
+{
+    iterator it = _lower_bound (npu_id);
+    if (it != end() && it->first == npu_id) {
+        return std::make_pair (it, false);
+    }
+
+    size_t pos = it - begin();
+    if (_size == _capacity) {
+        reserve (_capacity * 2);
+    }
+    it = begin() + pos;
+    std::copy_backward (it, end(), end() + 1);
+    *it = value_type (npu_id, ndi_obj_id);
+    _size++;
+    return std::make_pair (it, true);
+}
+
+size_t nas::ndi_obj_id_table_t::erase (npu_id_t npu_id) noexcept
+{
+    iterator it = find (npu_id);
+    if (it == end()) return 0;
+    erase (it);
+    return 1;
+}
+
+nas::ndi_obj_id_table_t::iterator nas::ndi_obj_id_table_t::erase (const_iterator pos) noexcept
+{
+    iterator it = begin() + (pos - cbegin());
+    std::copy (it + 1, end(), it);
+    _size--;
+    return it;
+}
+
+bool nas::ndi_obj_id_table_t::operator== (const ndi_obj_id_table_t& rhs) const noexcept
+{
+    if (_size != rhs._size) return false;
+    for (size_t i = 0; i < _size; i++) {
+        if (_data[i] != rhs._data[i]) return false;
+    }
+    return true;
+}
 
 extern "C" {
 
@@ -72,12 +192,7 @@ bool  nas_ndi_obj_id_table_get_id (const nas_ndi_obj_id_table_handle_t h,
 {
     auto& table = *(nas::ndi_obj_id_table_t *)h;
 
-    try {
-        *ndi_obj_id_p = table.at (npu_id);
-    } catch (...) {
-        return false;
-    }
-    return true;
+    return table.get (npu_id, *ndi_obj_id_p);
 }
 
 bool nas_ndi_obj_id_table_cps_serialize (const nas_ndi_obj_id_table_handle_t h,
@@ -89,6 +204,15 @@ bool nas_ndi_obj_id_table_cps_serialize (const nas_ndi_obj_id_table_handle_t h,
     return nas::ndi_obj_id_table_cps_serialize (table, cps_obj, attr_id_list, attr_id_size);
 }
 
+bool nas_ndi_obj_id_table_cps_serialize_compact (const nas_ndi_obj_id_table_handle_t h,
+                                                 cps_api_object_t cps_obj,
+                                                 cps_api_attr_id_t *attr_id_list,
+                                                 size_t attr_id_size)
+{
+    auto& table = *(nas::ndi_obj_id_table_t *)h;
+    return nas::ndi_obj_id_table_cps_serialize_compact (table, cps_obj, attr_id_list, attr_id_size);
+}
+
 bool
 nas_ndi_obj_id_table_cps_unserialize (nas_ndi_obj_id_table_handle_t  h,
                                       cps_api_object_t cps_obj,
@@ -107,15 +231,91 @@ static constexpr cps_api_attr_id_t OPAQUE_INST_ATTR_ID_START = 1;
 static constexpr cps_api_attr_id_t OPAQUE_NPU_ATTR_ID = 1;
 static constexpr cps_api_attr_id_t OPAQUE_NDI_OBJ_ATTR_ID = 2;
 
-// C++ Serialize and  Unserialize APIs
-bool nas::ndi_obj_id_table_cps_serialize (const ndi_obj_id_table_t& table,
-                                          cps_api_object_t cps_obj,
-                                          cps_api_attr_id_t *attr_id_list,
-                                          size_t attr_id_size)
+/*
+ * Compact encoding - a single binary attribute holding the header followed
+ * by hdr.count packed entries. The magic can never be mistaken for the
+ * leading instance attribute ID of the nested encoding.
+ */
+static constexpr uint32_t OPAQUE_COMPACT_MAGIC = 0x4e444f49; /* "IODN" */
+static constexpr uint8_t  OPAQUE_COMPACT_VERSION = 1;
+
+struct __attribute__((packed)) opaque_compact_hdr_t {
+    uint32_t  magic;
+    uint8_t   version;
+    uint8_t   reserved;
+    uint16_t  count;
+};
+
+struct __attribute__((packed)) opaque_compact_entry_t {
+    uint32_t  npu_id;
+    uint64_t  ndi_obj_id;
+};
+
+static constexpr size_t OPAQUE_COMPACT_INLINE_SZ =
+    sizeof (opaque_compact_hdr_t) +
+    nas::ndi_obj_id_table_t::INLINE_ENTRIES * sizeof (opaque_compact_entry_t);
+
+bool nas::ndi_obj_id_table_cps_serialize_compact (const ndi_obj_id_table_t& table,
+                                                  cps_api_object_t cps_obj,
+                                                  cps_api_attr_id_t *attr_id_list,
+                                                  size_t attr_id_size)
 {
-    std::vector<cps_api_attr_id_t> internal_ids (attr_id_list,
-                                                 attr_id_list+attr_id_size);
+    if (table.size () > UINT16_MAX) return false;
+
+    size_t len = sizeof (opaque_compact_hdr_t) + table.size () * sizeof (opaque_compact_entry_t);
+    uint8_t inline_buf[OPAQUE_COMPACT_INLINE_SZ];
+    std::vector<uint8_t> heap_buf;
+    uint8_t* buf = inline_buf;
+    if (len > sizeof (inline_buf)) {
+        heap_buf.resize (len);
+        buf = heap_buf.data ();
+    }
 
+    opaque_compact_hdr_t hdr = {OPAQUE_COMPACT_MAGIC, OPAQUE_COMPACT_VERSION, 0,
+                                (uint16_t) table.size ()};
+    memcpy (buf, &hdr, sizeof (hdr));
+    auto entry_p = (opaque_compact_entry_t *) (buf + sizeof (hdr));
+    for (auto& map_elem: table) {
+        entry_p->npu_id = map_elem.first;
+        entry_p->ndi_obj_id = map_elem.second;
+        entry_p++;
+    }
+
+    return cps_api_object_e_add (cps_obj, attr_id_list, attr_id_size,
+                                 cps_api_object_ATTR_T_BIN, buf, len);
+}
+
+/* Returns false if the attribute is not in the compact encoding */
+static bool _unserialize_compact (nas::ndi_obj_id_table_t& table,
+                                  cps_api_object_attr_t attr)
+{
+    size_t len = cps_api_object_attr_len (attr);
+    auto buf = (const uint8_t *) cps_api_object_attr_data_bin (attr);
+
+    opaque_compact_hdr_t hdr;
+    if (len < sizeof (hdr)) return false;
+    memcpy (&hdr, buf, sizeof (hdr));
+    if (hdr.magic != OPAQUE_COMPACT_MAGIC || hdr.version != OPAQUE_COMPACT_VERSION ||
+        len != sizeof (hdr) + hdr.count * sizeof (opaque_compact_entry_t)) {
+        return false;
+    }
+
+    nas::ndi_obj_id_table_t  temp_table;
+    temp_table.reserve (hdr.count);
+    auto entry_p = (const opaque_compact_entry_t *) (buf + sizeof (hdr));
+    for (size_t i = 0; i < hdr.count; i++, entry_p++) {
+        temp_table[(npu_id_t) entry_p->npu_id] = entry_p->ndi_obj_id;
+    }
+    table = std::move (temp_table);
+    return true;
+}
+
+// C++ Serialize and  Unserialize APIs
+/* internal_ids holds the attribute ID hierarchy of the table on entry and on return */
+static bool _serialize_nested (const nas::ndi_obj_id_table_t& table,
+                               cps_api_object_t cps_obj,
+                               std::vector<cps_api_attr_id_t>& internal_ids)
+{
     cps_api_attr_id_t  inst_attr_id = OPAQUE_INST_ATTR_ID_START;
 
     for (auto map_elem: table) {
@@ -150,6 +350,84 @@ bool nas::ndi_obj_id_table_cps_serialize (const ndi_obj_id_table_t& table,
     return true;
 }
 
+bool nas::ndi_obj_id_table_cps_serialize (const ndi_obj_id_table_t& table,
+                                          cps_api_object_t cps_obj,
+                                          cps_api_attr_id_t *attr_id_list,
+                                          size_t attr_id_size)
+{
+    std::vector<cps_api_attr_id_t> internal_ids (attr_id_list,
+                                                 attr_id_list+attr_id_size);
+    return _serialize_nested (table, cps_obj, internal_ids);
+}
+
+/* Approximate CPS object space taken by a serialized table */
+static constexpr size_t OPAQUE_CPS_ATTR_OVERHEAD = 16;
+
+static size_t _serialized_len (const nas::ndi_obj_id_table_t& table, bool compact)
+{
+    if (compact) {
+        return OPAQUE_CPS_ATTR_OVERHEAD + sizeof (opaque_compact_hdr_t) +
+               table.size () * sizeof (opaque_compact_entry_t);
+    }
+    return OPAQUE_CPS_ATTR_OVERHEAD + table.size () *
+           (3 * OPAQUE_CPS_ATTR_OVERHEAD + sizeof (uint32_t) + sizeof (uint64_t));
+}
+
+bool nas::ndi_obj_id_table_cps_serialize_list (const ndi_obj_id_table_t* const tables[],
+                                               size_t count,
+                                               cps_api_object_list_t obj_list,
+                                               cps_api_attr_id_t *attr_id_list,
+                                               size_t attr_id_size,
+                                               bool compact)
+{
+    std::vector<cps_api_attr_id_t> internal_ids (attr_id_list,
+                                                 attr_id_list+attr_id_size);
+    internal_ids.reserve (attr_id_size + 2);
+
+    for (size_t i = 0; i < count; i++) {
+        cps_api_object_t cps_obj = cps_api_object_list_get (obj_list, i);
+        if (cps_obj == NULL) {
+            cps_obj = cps_api_object_create ();
+            if (cps_obj == NULL) return false;
+            if (!cps_api_object_list_append (obj_list, cps_obj)) {
+                cps_api_object_delete (cps_obj);
+                return false;
+            }
+        }
+        cps_api_object_reserve (cps_obj, cps_api_object_to_array_len (cps_obj) +
+                                         _serialized_len (*tables[i], compact));
+
+        bool ok = compact ?
+            ndi_obj_id_table_cps_serialize_compact (*tables[i], cps_obj, attr_id_list, attr_id_size) :
+            _serialize_nested (*tables[i], cps_obj, internal_ids);
+        if (!ok) {
+            NAS_COM_ERR ("Failed to serialize table %lu of %lu\n", i, count);
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t nas::ndi_obj_id_table_cps_unserialize_list (std::vector<ndi_obj_id_table_t>& tables,
+                                                   cps_api_object_list_t obj_list,
+                                                   cps_api_attr_id_t *attr_id_list,
+                                                   size_t attr_id_size)
+{
+    size_t count = cps_api_object_list_size (obj_list);
+    size_t done = 0;
+    tables.resize (count);
+
+    for (size_t i = 0; i < count; i++) {
+        if (ndi_obj_id_table_cps_unserialize (tables[i], cps_api_object_list_get (obj_list, i),
+                                              attr_id_list, attr_id_size)) {
+            done++;
+        } else {
+            tables[i].clear ();
+        }
+    }
+    return done;
+}
+
 bool nas::ndi_obj_id_table_cps_unserialize (ndi_obj_id_table_t&  table,
                                             cps_api_object_t cps_obj,
                                             cps_api_attr_id_t *attr_id_list,
@@ -163,6 +441,10 @@ bool nas::ndi_obj_id_table_cps_unserialize (ndi_obj_id_table_t&  table,
         return false;
     }
 
+    if (_unserialize_compact (table, it_list.attr)) {
+        return true;
+    }
+
     int inst = 0;
     nas::ndi_obj_id_table_t  temp_table;
 
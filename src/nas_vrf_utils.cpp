@@ -22,18 +22,26 @@
 #include "event_log.h"
 #include "std_assert.h"
 #include "std_rw_lock.h"
+#include "std_mutex_lock.h"
 #include "std_utils.h"
 
+#include <atomic>
 #include <unordered_map>
+#include <vector>
 #include <memory>
+#include <new>
+#include <string.h>
 
+/* FNV-1a - every character affects every bit of the hash so names that
+ * differ only in a trailing digit (vrf1, vrf2, vrf10...) spread evenly */
 struct _vrf_key_hash {
     size_t operator()(const char *key) const {
-        size_t _hash = 0;
+        uint64_t _hash = 0xcbf29ce484222325ULL;
         while (*key!='\0') {
-            _hash ^= *key++ << 1;
+            _hash ^= (uint8_t)*key++;
+            _hash *= 0x100000001b3ULL;
         }
-        return _hash;
+        return (size_t)_hash;
     }
 };
 
@@ -43,10 +51,115 @@ struct _vrf_key_equal {
     }
 };
 
-static auto vrf_map = new std::unordered_map<const char *,nas_vrf_ctrl_t *, _vrf_key_hash,_vrf_key_equal>;
+/*
+ * The VRF table is published as an immutable snapshot. Writers copy the
+ * current snapshot, apply the change and swap the new snapshot in, readers
+ * only load the current snapshot pointer.
+ *
+ * A snapshot that has been replaced is freed once no reader holds it. Each
+ * reader thread owns a reader slot in which it advertises the snapshot it
+ * is using, threads beyond VRF_READER_SLOTS fall back to rw_lock.
+ */
+struct vrf_table_t {
+    /* Keys point at the vrf_name of the record they map to */
+    std::unordered_map<const char *,nas_vrf_ctrl_t *, _vrf_key_hash,_vrf_key_equal> vrf_map;
+
+    /* Direct index over the internal VRF-id */
+    nas_vrf_ctrl_t *vrf_id_table[NAS_MAX_VRF_ID + 1] = {};
+
+    /* Index over the NPU VRF object id */
+    std::unordered_map<nas_obj_id_t, nas_vrf_ctrl_t *> vrf_obj_id_map;
+
+    /* Bumped by every published change */
+    uint64_t gen = 0;
+
+    vrf_table_t() {}
+    vrf_table_t(const vrf_table_t &src);
+    vrf_table_t & operator=(const vrf_table_t &) = delete;
+    ~vrf_table_t();
+};
+
+static const size_t VRF_READER_SLOTS = 128;
+
+struct alignas(64) vrf_reader_slot_t {
+    std::atomic<const vrf_table_t *> table;
+    std::atomic<bool> used;
+};
+
+static vrf_reader_slot_t vrf_reader_slots[VRF_READER_SLOTS];
 
+/* Claims a reader slot for the lifetime of the thread */
+struct vrf_reader_slot_owner_t {
+    vrf_reader_slot_t *slot = nullptr;
+
+    vrf_reader_slot_owner_t() {
+        for (auto &s : vrf_reader_slots) {
+            bool used = false;
+            if (s.used.compare_exchange_strong(used, true)) {
+                slot = &s;
+                break;
+            }
+        }
+    }
+    ~vrf_reader_slot_owner_t() {
+        if (slot != nullptr) slot->used.store(false, std::memory_order_release);
+    }
+};
+
+static thread_local vrf_reader_slot_owner_t vrf_reader;
+
+static std::atomic<const vrf_table_t *> vrf_table{new vrf_table_t};
+
+/* Replaced snapshots still held by a reader */
+static auto vrf_retired = new std::vector<const vrf_table_t *>;
+
+/* Serializes writers */
+static std_mutex_lock_create_static_init_fast(vrf_write_mutex);
+
+/* Only taken by readers without a reader slot */
 static std_rw_lock_t rw_lock = PTHREAD_RWLOCK_INITIALIZER;
 
+/**
+ * Holds the current snapshot for the lifetime of the object.
+ * Nested readers in the same thread share the outer reader's snapshot.
+ */
+class vrf_table_reader_t {
+    vrf_reader_slot_t *_slot;
+    const vrf_table_t *_t;
+    bool _nested = false;
+public:
+    vrf_table_reader_t() : _slot(vrf_reader.slot) {
+        if (_slot == nullptr) {
+            std_rw_rlock(&rw_lock);
+            _t = vrf_table.load(std::memory_order_acquire);
+            return;
+        }
+        _t = _slot->table.load(std::memory_order_relaxed);
+        if (_t != nullptr) {
+            _nested = true;
+            return;
+        }
+        const vrf_table_t *t;
+        do {
+            t = vrf_table.load(std::memory_order_acquire);
+            _slot->table.store(t);
+        } while (t != vrf_table.load());
+        _t = t;
+    }
+    ~vrf_table_reader_t() {
+        if (_slot == nullptr) {
+            std_rw_unlock(&rw_lock);
+        } else if (!_nested) {
+            _slot->table.store(nullptr, std::memory_order_release);
+        }
+    }
+    vrf_table_reader_t(const vrf_table_reader_t &) = delete;
+    vrf_table_reader_t & operator=(const vrf_table_reader_t &) = delete;
+
+    const vrf_table_t *get() const { return _t; }
+    const vrf_table_t *operator->() const { return _t; }
+};
+
 static inline void print_record(const nas_vrf_ctrl_t *p) {
     EV_LOGGING(NAS_VRF,ERR,"VRF-INFO","VRF:%s vrf_id:0x%lx",
                p->vrf_name,p->vrf_id);
@@ -55,48 +168,99 @@ static inline void print_record(const nas_vrf_ctrl_t *p) {
 /**
  * Search for the record - fill it in based on the search parameters and return it
  */
-static nas_vrf_ctrl_t *_locate(const char *vrf_name) {
-    auto it = vrf_map->find(vrf_name);
-    if (it == vrf_map->end()) return NULL;
+static nas_vrf_ctrl_t *_locate(const vrf_table_t *t, const char *vrf_name) {
+    auto it = t->vrf_map.find(vrf_name);
+    if (it == t->vrf_map.end()) return NULL;
     return it->second;
 }
 
-static bool _add(nas_vrf_ctrl_t *rec) {
-    char *key = (char*)malloc(NAS_VRF_NAME_SZ+1);
+static nas_vrf_ctrl_t *_locate_vrf_id(const vrf_table_t *t, hal_vrf_id_t vrf_int_id) {
+    if (vrf_int_id > NAS_MAX_VRF_ID) return NULL;
+    return t->vrf_id_table[vrf_int_id];
+}
 
-    if (key == NULL) {
-        EV_LOGGING(NAS_VRF,ERR,"VRF-ADD","Memory alloc. failed for VRF:%s",
-                   rec->vrf_name);
+static nas_vrf_ctrl_t *_locate_obj_id(const vrf_table_t *t, nas_obj_id_t obj_id) {
+    auto it = t->vrf_obj_id_map.find(obj_id);
+    if (it == t->vrf_obj_id_map.end()) return NULL;
+    return it->second;
+}
+
+/* Internal VRF-id 0 is only assigned to the default VRF, for the others it means not yet assigned */
+static bool _vrf_id_valid(const nas_vrf_ctrl_t *p) {
+    if (p->vrf_int_id > NAS_MAX_VRF_ID) return false;
+    return (p->vrf_int_id != NAS_DEFAULT_VRF_ID) || (strcmp(p->vrf_name, NAS_DEFAULT_VRF_NAME) == 0);
+}
+
+static void _vrf_id_index_add(vrf_table_t *t, nas_vrf_ctrl_t *p) {
+    if (!_vrf_id_valid(p)) return;
+    if (t->vrf_id_table[p->vrf_int_id] != nullptr && t->vrf_id_table[p->vrf_int_id] != p) {
+        EV_LOGGING(NAS_VRF,ERR,"VRF-ADD","VRF:%s internal id %d already used by VRF:%s",
+                   p->vrf_name, p->vrf_int_id, t->vrf_id_table[p->vrf_int_id]->vrf_name);
+    }
+    t->vrf_id_table[p->vrf_int_id] = p;
+}
+
+static void _vrf_id_index_del(vrf_table_t *t, nas_vrf_ctrl_t *p) {
+    if (_locate_vrf_id(t, p->vrf_int_id) == p) {
+        t->vrf_id_table[p->vrf_int_id] = nullptr;
+    }
+}
+
+static void _index_add(vrf_table_t *t, nas_vrf_ctrl_t *p) {
+    t->vrf_map.insert(std::make_pair((const char*)p->vrf_name, p));
+    _vrf_id_index_add(t, p);
+    if (p->vrf_id != 0) {
+        t->vrf_obj_id_map[p->vrf_id] = p;
+    }
+}
+
+vrf_table_t::vrf_table_t(const vrf_table_t &src) : gen(src.gen + 1) {
+    vrf_map.reserve(src.vrf_map.size());
+    for (auto &it : src.vrf_map) {
+        nas_vrf_ctrl_t *p = new nas_vrf_ctrl_t(*it.second);
+        _index_add(this, p);
+    }
+}
+
+vrf_table_t::~vrf_table_t() {
+    for (auto &it : vrf_map) {
+        delete it.second;
+    }
+}
+
+static bool _add(vrf_table_t *t, nas_vrf_ctrl_t *rec) {
+    if (_locate(t, rec->vrf_name) != nullptr) {
+        EV_LOGGING(NAS_VRF,ERR,"VRF-ADD","VRF:%s info already exists!", rec->vrf_name);
         return false;
     }
-    memset(key, 0, NAS_VRF_NAME_SZ+1);
 
-    safestrncpy(key, rec->vrf_name, NAS_VRF_NAME_SZ+1);
-    nas_vrf_ctrl_t *p = new nas_vrf_ctrl_t;
+    nas_vrf_ctrl_t *p = new (std::nothrow) nas_vrf_ctrl_t;
 
     if (p == nullptr) {
         EV_LOGGING(NAS_VRF,ERR,"VRF-ADD","Memory alloc. failed for VRF:%s info",
                    rec->vrf_name);
-        free(key);
         return false;
     }
     memcpy(p, rec, sizeof(nas_vrf_ctrl_t));
-    vrf_map->insert(std::make_pair((const char*)key, p));
+    p->vrf_name[NAS_VRF_NAME_SZ] = '\0';
+    _index_add(t, p);
     EV_LOGGING(NAS_VRF, INFO, "VRF-ADD", "VRF:%s 0x%lx info added successfully!",
                rec->vrf_name, rec->vrf_id);
     return true;
 }
 
-static bool _update(nas_vrf_ctrl_t *rec) {
+static bool _update(vrf_table_t *t, nas_vrf_ctrl_t *rec) {
     /* Update the internal VRF-id on the existing info. */
-    nas_vrf_ctrl_t *_p = _locate(rec->vrf_name);
+    nas_vrf_ctrl_t *_p = _locate(t, rec->vrf_name);
     if (_p == nullptr) {
         EV_LOGGING(NAS_VRF,ERR,"VRF-ADD","VRF info. update when entry doesnt exist for:%s",
                    rec->vrf_name);
         return false;
     }
     if (rec->vrf_int_id != 0) {
+        _vrf_id_index_del(t, _p);
         _p->vrf_int_id = rec->vrf_int_id;
+        _vrf_id_index_add(t, _p);
     }
     return true;
 }
@@ -104,80 +268,157 @@ static bool _update(nas_vrf_ctrl_t *rec) {
 /**
  * Remove any records associated with this entry
  */
-static void _cleanup(nas_vrf_ctrl_t *rec) {
-    auto it = vrf_map->find((const char*)rec->vrf_name);
-    if (it == vrf_map->end()) {
+static bool _cleanup(vrf_table_t *t, nas_vrf_ctrl_t *rec) {
+    auto it = t->vrf_map.find((const char*)rec->vrf_name);
+    if (it == t->vrf_map.end()) {
         EV_LOGGING(NAS_VRF,ERR,"VRF-DEL","VRF:%s info does not exist!",
                    rec->vrf_name);
-        return;
+        return false;
     }
     nas_vrf_ctrl_t *tmp_rec = it->second;
-    free((char*)it->first);
-    vrf_map->erase(it);
+    t->vrf_map.erase(it);
+    _vrf_id_index_del(t, tmp_rec);
+    if (_locate_obj_id(t, tmp_rec->vrf_id) == tmp_rec) {
+        t->vrf_obj_id_map.erase(tmp_rec->vrf_id);
+    }
     delete tmp_rec;
     EV_LOGGING(NAS_VRF, INFO, "VRF-DEL","VRF:%s info deleted successfully!",
                rec->vrf_name);
+    return true;
+}
+
+static bool _table_in_use(const vrf_table_t *t) {
+    for (auto &s : vrf_reader_slots) {
+        if (s.table.load() == t) return true;
+    }
+    return false;
+}
+
+/* Called with vrf_write_mutex held */
+static void _publish(vrf_table_t *next) {
+    const vrf_table_t *old = vrf_table.exchange(next);
+
+    /* Wait out the readers without a reader slot */
+    { std_rw_lock_write_guard l(&rw_lock); }
+
+    vrf_retired->push_back(old);
+    auto it = vrf_retired->begin();
+    while (it != vrf_retired->end()) {
+        if (_table_in_use(*it)) {
+            ++it;
+            continue;
+        }
+        delete *it;
+        it = vrf_retired->erase(it);
+    }
 }
 
 extern "C" {
 
 t_std_error nas_update_vrf_info (nas_vrf_op_t op, nas_vrf_ctrl_t *p) {
     STD_ASSERT(p!=NULL);
-    std_rw_lock_write_guard l(&rw_lock);
+    std_mutex_simple_lock_guard l(&vrf_write_mutex);
+    std::unique_ptr<vrf_table_t> next(new (std::nothrow) vrf_table_t(*vrf_table.load()));
+    if (next.get() == nullptr) {
+        EV_LOGGING(NAS_VRF,ERR,"VRF-UPD","Memory alloc. failed for VRF:%s info", p->vrf_name);
+        return STD_ERR(COM,NOMEM,0);
+    }
+
+    bool changed = false;
     if (op == NAS_VRF_OP_ADD) {
-        _add(p);
+        changed = _add(next.get(), p);
     } else if (op == NAS_VRF_OP_UPD) {
-        _update(p);
+        changed = _update(next.get(), p);
     } else if (op == NAS_VRF_OP_DEL) {
-        _cleanup(p);
+        changed = _cleanup(next.get(), p);
+    }
+    if (changed) {
+        _publish(next.release());
     }
     return STD_ERR_OK;
 }
 
 t_std_error nas_get_vrf_obj_id_from_vrf_name(const char *vrf_name, nas_obj_id_t *obj_id) {
     STD_ASSERT(vrf_name!=NULL);
-    std_rw_lock_read_guard l(&rw_lock);
-    nas_vrf_ctrl_t *_p = _locate(vrf_name);
+    vrf_table_reader_t t;
+    nas_vrf_ctrl_t *_p = _locate(t.get(), vrf_name);
     if (_p==nullptr) {
         return STD_ERR(COM,PARAM,0);
     }
 
     *obj_id = _p->vrf_id;
-    EV_LOGGING(NAS_VRF, INFO, "VRF-GET","VRF:%s - VRF_id 0x%lx successful!",
-               vrf_name, _p->vrf_id);
     return STD_ERR_OK;
 }
 
 t_std_error nas_get_vrf_internal_id_from_vrf_name(const char *vrf_name, hal_vrf_id_t *vrf_id) {
     STD_ASSERT(vrf_name!=NULL);
-    std_rw_lock_read_guard l(&rw_lock);
-    nas_vrf_ctrl_t *_p = _locate(vrf_name);
+    vrf_table_reader_t t;
+    nas_vrf_ctrl_t *_p = _locate(t.get(), vrf_name);
     if (_p==nullptr) {
         return STD_ERR(COM,PARAM,0);
     }
 
     *vrf_id = _p->vrf_int_id;
-    EV_LOGGING(NAS_VRF, INFO, "VRF-GET","VRF:%s - VRF_id: %d successful!",
-               vrf_name, _p->vrf_int_id);
     return STD_ERR_OK;
 }
 
 t_std_error nas_get_vrf_ctrl_from_vrf_name(const char *vrf_name, nas_vrf_ctrl_t *vrf_ctrl_blk) {
     STD_ASSERT(vrf_name != NULL);
-    std_rw_lock_read_guard l(&rw_lock);
-    nas_vrf_ctrl_t *tmp = _locate(vrf_name);
+    vrf_table_reader_t t;
+    nas_vrf_ctrl_t *tmp = _locate(t.get(), vrf_name);
+    if (tmp == nullptr) {
+        return STD_ERR(COM, PARAM, 0);
+    }
+    *vrf_ctrl_blk = *tmp;
+    return STD_ERR_OK;
+}
+
+t_std_error nas_get_vrf_ctrl_from_vrf_id(hal_vrf_id_t vrf_int_id, nas_vrf_ctrl_t *vrf_ctrl_blk) {
+    STD_ASSERT(vrf_ctrl_blk != NULL);
+    vrf_table_reader_t t;
+    nas_vrf_ctrl_t *tmp = _locate_vrf_id(t.get(), vrf_int_id);
+    if (tmp == nullptr) {
+        return STD_ERR(COM, PARAM, 0);
+    }
+    *vrf_ctrl_blk = *tmp;
+    return STD_ERR_OK;
+}
+
+t_std_error nas_get_vrf_ctrl_from_obj_id(nas_obj_id_t obj_id, nas_vrf_ctrl_t *vrf_ctrl_blk) {
+    STD_ASSERT(vrf_ctrl_blk != NULL);
+    vrf_table_reader_t t;
+    nas_vrf_ctrl_t *tmp = _locate_obj_id(t.get(), obj_id);
     if (tmp == nullptr) {
         return STD_ERR(COM, PARAM, 0);
     }
     *vrf_ctrl_blk = *tmp;
     return STD_ERR_OK;
 }
+
+uint64_t nas_get_vrf_table_gen(void) {
+    vrf_table_reader_t t;
+    return t->gen;
+}
+
+size_t nas_walk_vrf_ctrl(nas_vrf_walk_fn fn, void *context, uint64_t *gen) {
+    STD_ASSERT(fn != NULL);
+    vrf_table_reader_t t;
+    if (gen != nullptr) *gen = t->gen;
+
+    size_t visited = 0;
+    for (auto &it : t->vrf_map) {
+        ++visited;
+        if (!fn(it.second, context)) break;
+    }
+    return visited;
+}
 }
 
 void nas_get_all_vrf_ctrl(std::vector<nas_vrf_ctrl_t> &v) {
-    std_rw_lock_read_guard l(&rw_lock);
-    auto it = vrf_map->begin();
-    auto end = vrf_map->end();
+    vrf_table_reader_t t;
+    v.reserve(v.size() + t->vrf_map.size());
+    auto it = t->vrf_map.begin();
+    auto end = t->vrf_map.end();
 
     for ( ; it != end ; ++it ) {
         v.push_back(*(it->second));
@@ -185,9 +426,9 @@ void nas_get_all_vrf_ctrl(std::vector<nas_vrf_ctrl_t> &v) {
 }
 
 void dump_tree_vrf() {
-    std_rw_lock_read_guard l(&rw_lock);
-    auto it = vrf_map->cbegin();
-    auto end = vrf_map->cend();
+    vrf_table_reader_t t;
+    auto it = t->vrf_map.cbegin();
+    auto end = t->vrf_map.cend();
 
     for ( ; it != end ; ++it ) {
         print_record(it->second);
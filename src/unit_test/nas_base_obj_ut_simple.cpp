@@ -21,14 +21,40 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
 #include "gtest/gtest.h"
 #include "nas_base_ut_simple_derived_obj.h"
+#include "nas_base_ndi_utl.h"
 #include "std_error_codes.h"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// NDI stubs are called from several threads in parallel NPU push
 #define RESET_NPU_ID 10
-npu_id_t simulate_ndi_fail = RESET_NPU_ID ;
-npu_id_t simulate_ndi_attr1_fail = RESET_NPU_ID;
-npu_id_t simulate_ndi_attr2_fail = RESET_NPU_ID;
+std::atomic<npu_id_t> simulate_ndi_fail {RESET_NPU_ID};
+std::atomic<npu_id_t> simulate_ndi_attr1_fail {RESET_NPU_ID};
+std::atomic<npu_id_t> simulate_ndi_attr2_fail {RESET_NPU_ID};
+// Objects present in NDI across all NPUs
+std::atomic<int> ndi_obj_count {0};
+// Simulated hardware programming latency of NDI create/delete
+std::atomic<useconds_t> ndi_delay_us {0};
+// Attribute sets of NDI objects that were already deleted
+std::mutex ndi_live_mutex;
+std::set<size_t> ndi_live_ids;
+std::atomic<int> ndi_stale_set_count {0};
+// Fail the Nth Attr1 set from now, 0 to never fail
+std::atomic<int> ndi_attr1_fail_call {0};
+// Last Attr2 value set per NPU
+uint_t ndi_attr2_val[RESET_NPU_ID];
+// Attributes set in NDI in the order they were set
+std::vector<nas_attr_id_t> ndi_attr_order;
+// Silence NDI stub logs in benchmarks
+bool ndi_quiet = false;
+#define NDI_LOG(...) do { if (!ndi_quiet) printf (__VA_ARGS__); } while (0)
 
 ////////////
 // NDI API stubs
@@ -37,15 +63,21 @@ t_std_error ndi_ut_obj_create (npu_id_t npu_id,
                                ndi_ut_obj_t* ndi_ut_obj_p,
                                size_t* ndi_ut_obj_id)
 {
-    static size_t count = 0;
+    static std::atomic<size_t> count {0};
+    if (ndi_delay_us) usleep (ndi_delay_us);
     if (simulate_ndi_fail == npu_id) {
-        printf ("Simulate NDI Create failure in NPU %d\r\n", npu_id);
+        NDI_LOG ("Simulate NDI Create failure in NPU %d\r\n", npu_id);
         simulate_ndi_fail = RESET_NPU_ID ;
         return STD_ERR (NPU, FAIL, 2);
     } else {
         *ndi_ut_obj_id = ++count;
-        printf ("   NDI Object Create in NPU %d\r\n", npu_id);
-        printf ("     Generated NDI ID %ld\r\n", *ndi_ut_obj_id);
+        ++ndi_obj_count;
+        {
+            std::lock_guard<std::mutex> l {ndi_live_mutex};
+            ndi_live_ids.insert (*ndi_ut_obj_id);
+        }
+        NDI_LOG ("   NDI Object Create in NPU %d\r\n", npu_id);
+        NDI_LOG ("     Generated NDI ID %ld\r\n", *ndi_ut_obj_id);
     }
     return STD_ERR_OK;
 }
@@ -53,26 +85,43 @@ t_std_error ndi_ut_obj_create (npu_id_t npu_id,
 t_std_error ndi_ut_obj_delete (npu_id_t npu_id,
                                size_t ndi_ut_obj_id)
 {
+    if (ndi_delay_us) usleep (ndi_delay_us);
     if (simulate_ndi_fail == npu_id) {
-        printf ("Simulate NDI Delete failure in NPU %d\r\n", npu_id);
+        NDI_LOG ("Simulate NDI Delete failure in NPU %d\r\n", npu_id);
         simulate_ndi_fail = RESET_NPU_ID ;
         return STD_ERR (NPU, FAIL, 2);
     } else {
-        printf ("   NDI Object Delete in NPU %d NDI Obj Id %ld\r\n",
+        NDI_LOG ("   NDI Object Delete in NPU %d NDI Obj Id %ld\r\n",
                 npu_id, ndi_ut_obj_id);
+        --ndi_obj_count;
+        std::lock_guard<std::mutex> l {ndi_live_mutex};
+        ndi_live_ids.erase (ndi_ut_obj_id);
     }
     return STD_ERR_OK;
 }
 
+static void _ndi_check_live (size_t ndi_ut_obj_id, nas_attr_id_t attr_id)
+{
+    if (ndi_delay_us) usleep (ndi_delay_us);
+    std::lock_guard<std::mutex> l {ndi_live_mutex};
+    if (ndi_live_ids.count (ndi_ut_obj_id) == 0) ++ndi_stale_set_count;
+    ndi_attr_order.push_back (attr_id);
+}
+
 t_std_error ndi_ut_obj_attr1_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
                                   uint_t attr_val)
 {
+    _ndi_check_live (ndi_ut_obj_id, BASE_UT_ATTR1);
+    if (ndi_attr1_fail_call > 0 && --ndi_attr1_fail_call == 0) {
+        NDI_LOG ("Simulate NDI Attr1 set failure in NPU %d\r\n", npu_id);
+        return STD_ERR (NPU, FAIL, 2);
+    }
     if (simulate_ndi_attr1_fail == npu_id) {
-        printf ("Simulate NDI Attr1 set failure in NPU %d\r\n", npu_id);
+        NDI_LOG ("Simulate NDI Attr1 set failure in NPU %d\r\n", npu_id);
         simulate_ndi_attr1_fail = RESET_NPU_ID;
         return STD_ERR (NPU, FAIL, 2);
     } else {
-        printf ("   NDI Object Attr1 Modify in NPU %d NDI Obj Id %ld Val %d\r\n",
+        NDI_LOG ("   NDI Object Attr1 Modify in NPU %d NDI Obj Id %ld Val %d\r\n",
                 npu_id, ndi_ut_obj_id, attr_val);
     }
     return STD_ERR_OK;
@@ -81,13 +130,35 @@ t_std_error ndi_ut_obj_attr1_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
 t_std_error ndi_ut_obj_attr2_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
                                   uint_t attr_val)
 {
+    _ndi_check_live (ndi_ut_obj_id, BASE_UT_ATTR2);
     if (simulate_ndi_attr2_fail == npu_id) {
-        printf ("Simulate NDI Attr2 set failure in NPU %d\r\n", npu_id);
+        NDI_LOG ("Simulate NDI Attr2 set failure in NPU %d\r\n", npu_id);
         simulate_ndi_attr2_fail = RESET_NPU_ID;
         return STD_ERR (NPU, FAIL, 2);
     } else {
-        printf ("   NDI Object Attr2 Modify in NPU %d NDI Obj Id %ld Val %d\r\n",
+        NDI_LOG ("   NDI Object Attr2 Modify in NPU %d NDI Obj Id %ld Val %d\r\n",
                 npu_id, ndi_ut_obj_id, attr_val);
+        ndi_attr2_val[npu_id] = attr_val;
+    }
+    return STD_ERR_OK;
+}
+
+// Bulk attribute set calls and last Attr1 value programmed per NPU
+std::atomic<int> ndi_bulk_set_count {0};
+uint_t ndi_bulk_attr1[RESET_NPU_ID];
+
+t_std_error ndi_ut_obj_attrs_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
+                                  const ndi_ut_obj_t* ndi_ut_obj_p)
+{
+    ++ndi_bulk_set_count;
+    if (simulate_ndi_attr1_fail == npu_id) {
+        NDI_LOG ("Simulate NDI Attrs set failure in NPU %d\r\n", npu_id);
+        simulate_ndi_attr1_fail = RESET_NPU_ID;
+        return STD_ERR (NPU, FAIL, 2);
+    } else {
+        NDI_LOG ("   NDI Object Attrs Modify in NPU %d NDI Obj Id %ld Val %d %d\r\n",
+                npu_id, ndi_ut_obj_id, ndi_ut_obj_p->attr1, ndi_ut_obj_p->attr2);
+        ndi_bulk_attr1[npu_id] = ndi_ut_obj_p->attr1;
     }
     return STD_ERR_OK;
 }
@@ -389,6 +460,388 @@ TEST (nas_base_obj_test, npu_rollback_test)
     }
 }
 
+TEST (nas_base_obj_test, parallel_npu_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+    nas::base_ndi_set_npu_workers (4);
+    ndi_delay_us = 20000;
+    int base_count = ndi_obj_count;
+
+    for (bool parallel: {false, true}) {
+        derived_obj_t obj_new {&logical_switch};
+        obj_new.set_push_parallel (parallel);
+        obj_new.set_attr1 (4);
+
+        auto start = std::chrono::steady_clock::now();
+        obj_new.commit_create (false);
+        auto end = std::chrono::steady_clock::now();
+        printf ("%s create on 4 NPUs: %ld ms\r\n", parallel ? "Parallel" : "Sequential",
+                (long) std::chrono::duration_cast<std::chrono::milliseconds> (end - start).count());
+        EXPECT_TRUE (ndi_obj_count == base_count + 4);
+        /* NDI IDs of every NPU are stored once the parallel push is done */
+        for (npu_id_t npu = 0; npu < 4; npu++) {
+            std::lock_guard<std::mutex> l {ndi_live_mutex};
+            EXPECT_TRUE (ndi_live_ids.count (obj_new.ndi_obj_id (npu)) == 1);
+        }
+
+        obj_new.commit_delete (false);
+        EXPECT_TRUE (ndi_obj_count == base_count);
+    }
+
+    /* Failure on one NPU rolls back every NPU that succeeded */
+    derived_obj_t obj_fail {&logical_switch};
+    obj_fail.set_push_parallel (true);
+    obj_fail.set_attr1 (4);
+    simulate_ndi_fail = 2;
+    EXPECT_THROW (obj_fail.commit_create (false), nas::base_exception);
+    EXPECT_TRUE (ndi_obj_count == base_count);
+    EXPECT_FALSE (obj_fail.is_created_in_ndi ());
+
+    derived_obj_t obj_orig {&logical_switch};
+    obj_orig.set_push_parallel (true);
+    obj_orig.set_attr1 (4);
+    obj_orig.commit_create (false);
+    derived_obj_t obj_modify {obj_orig};
+    obj_modify.set_attr1 (6);
+    simulate_ndi_attr1_fail = 3;
+    EXPECT_THROW (obj_modify.commit_modify (obj_orig, false), nas::base_exception);
+    obj_modify.set_attr1 (7);
+    obj_modify.commit_modify (obj_orig, false);
+
+    simulate_ndi_fail = 1;
+    EXPECT_THROW (obj_modify.commit_delete (false), nas::base_exception);
+    EXPECT_TRUE (ndi_obj_count == base_count + 4);
+    obj_modify.commit_delete (false);
+    EXPECT_TRUE (ndi_obj_count == base_count);
+
+    ndi_delay_us = 0;
+    nas::base_ndi_set_npu_workers (0);
+}
+
+TEST (nas_base_obj_test, bulk_attr_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+
+    for (bool parallel: {false, true}) {
+        nas::base_ndi_set_npu_workers (parallel ? 4 : 0);
+
+        derived_obj_t obj_orig {&logical_switch};
+        obj_orig.set_push_parallel (parallel);
+        obj_orig.set_bulk_push (true);
+        obj_orig.set_attr1 (4);
+        obj_orig.set_attr2 (2);
+        obj_orig.commit_create (false);
+
+        /* Both dirty attributes go to each NPU in one call */
+        derived_obj_t obj_modify {obj_orig};
+        obj_modify.set_attr1 (6);
+        obj_modify.set_attr2 (3);
+        int base_count = ndi_bulk_set_count;
+        obj_modify.commit_modify (obj_orig, false);
+        EXPECT_TRUE (ndi_bulk_set_count == base_count + 4);
+        for (npu_id_t npu = 0; npu < 4; npu++) EXPECT_TRUE (ndi_bulk_attr1[npu] == 6);
+
+        /* Failure on one NPU restores the old values on every NPU */
+        derived_obj_t obj_fail {obj_modify};
+        obj_fail.set_attr1 (8);
+        simulate_ndi_attr1_fail = 2;
+        EXPECT_THROW (obj_fail.commit_modify (obj_modify, false), nas::base_exception);
+        for (npu_id_t npu = 0; npu < 4; npu++) EXPECT_TRUE (ndi_bulk_attr1[npu] == 6);
+
+        obj_modify.commit_delete (false);
+    }
+    nas::base_ndi_set_npu_workers (0);
+
+    /* Default rollback restores each attribute even if one of them fails */
+    derived_obj_t obj_orig {&logical_switch};
+    obj_orig.set_attr1 (4);
+    obj_orig.set_attr2 (2);
+    obj_orig.commit_create (false);
+    derived_obj_t obj_modify {obj_orig};
+    obj_modify.set_attr1 (6);
+    obj_modify.set_attr2 (3);
+    // Attr1 of NPU 3 fails, then the Attr1 restore of NPU 2 in rollback
+    simulate_ndi_attr1_fail = 3;
+    ndi_attr1_fail_call = 6;
+    EXPECT_THROW (obj_modify.commit_modify (obj_orig, false), nas::base_exception);
+    EXPECT_TRUE (ndi_attr1_fail_call == 0);
+    for (npu_id_t npu = 0; npu < 3; npu++) EXPECT_TRUE (ndi_attr2_val[npu] == 2);
+    obj_orig.commit_delete (false);
+}
+
+TEST (nas_base_obj_test, attr_order_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+
+    derived_obj_t obj_orig {&logical_switch};
+    obj_orig.set_non_leaf_attr (BASE_UT_ATTR1);
+    obj_orig.set_attr1 (4);
+    obj_orig.commit_create (false);
+
+    /* Non-leaf Attr1 is still pushed before leaf Attr2 */
+    for (bool txn_push: {false, true}) {
+        derived_obj_t obj_modify {obj_orig};
+        obj_modify.set_attr1 (6);
+        obj_modify.set_attr2 (3);
+        ndi_attr_order.clear ();
+        if (txn_push) {
+            nas::base_txn_t txn;
+            txn.add_modify (obj_modify, obj_orig);
+            txn.commit ();
+        } else {
+            obj_modify.commit_modify (obj_orig, false);
+        }
+        ASSERT_TRUE (ndi_attr_order.size () == 8);
+        if (txn_push) {
+            // One NPU after another
+            for (size_t i = 0; i < 8; i++) {
+                EXPECT_TRUE (ndi_attr_order[i] == (i % 2 ? BASE_UT_ATTR2 : BASE_UT_ATTR1));
+            }
+        } else {
+            for (size_t i = 0; i < 8; i++) {
+                EXPECT_TRUE (ndi_attr_order[i] == (i < 4 ? BASE_UT_ATTR1 : BASE_UT_ATTR2));
+            }
+        }
+    }
+
+    obj_orig.commit_delete (false);
+}
+
+TEST (nas_base_obj_test, unchanged_attr_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+
+    /* Attribute tracking window starts at the class base attribute */
+    derived_obj_t obj_base {&logical_switch};
+    obj_base.set_attr2 (1);
+    EXPECT_TRUE (obj_base.dirty_attr_list ().base_attr_id () == BASE_UT_ATTR1);
+
+    derived_obj_t obj_orig {&logical_switch};
+    obj_orig.set_value_compare (true);
+    obj_orig.set_attr1 (4);
+    obj_orig.set_attr2 (2);
+    obj_orig.commit_create (false);
+
+    /* Attr1 re-sent with the same value is not pushed */
+    derived_obj_t obj_modify {obj_orig};
+    obj_modify.set_attr1 (4);
+    obj_modify.set_attr2 (3);
+    uint64_t skipped = nas::base_obj_t::skipped_attr_pushes ();
+    auto modified = obj_modify.commit_modify (obj_orig, false);
+    EXPECT_FALSE (modified.contains (BASE_UT_ATTR1));
+    EXPECT_TRUE (modified.contains (BASE_UT_ATTR2));
+    EXPECT_TRUE (nas::base_obj_t::skipped_attr_pushes () == skipped + 4);
+    EXPECT_TRUE (obj_modify.set_attr_list ().contains (BASE_UT_ATTR1));
+
+    /* Nothing reaches NDI, a failure would otherwise be hit */
+    derived_obj_t obj_same {obj_modify};
+    obj_same.set_attr1 (4);
+    obj_same.set_attr2 (3);
+    simulate_ndi_attr1_fail = 1;
+    simulate_ndi_attr2_fail = 1;
+    modified = obj_same.commit_modify (obj_modify, false);
+    EXPECT_TRUE (modified.empty ());
+    EXPECT_TRUE (nas::base_obj_t::skipped_attr_pushes () == skipped + 12);
+    simulate_ndi_attr1_fail = RESET_NPU_ID;
+    simulate_ndi_attr2_fail = RESET_NPU_ID;
+
+    /* Without value comparison every dirty attribute is pushed */
+    obj_same.set_value_compare (false);
+    derived_obj_t obj_push {obj_same};
+    obj_push.set_attr1 (4);
+    modified = obj_push.commit_modify (obj_same, false);
+    EXPECT_TRUE (modified.contains (BASE_UT_ATTR1));
+    EXPECT_TRUE (nas::base_obj_t::skipped_attr_pushes () == skipped + 12);
+
+    obj_push.commit_delete (false);
+}
+
+TEST (nas_base_obj_test, txn_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+    int base_count = ndi_obj_count;
+
+    std::vector<derived_obj_t> objs (3, derived_obj_t {&logical_switch});
+    nas::base_txn_t txn;
+    for (auto& obj: objs) {
+        obj.set_attr1 (5);
+        txn.add_create (obj);
+    }
+    /* Object validation still fails the add, nothing is queued */
+    derived_obj_t obj_bad {&logical_switch};
+    EXPECT_THROW (txn.add_create (obj_bad), nas::base_exception);
+    EXPECT_TRUE (txn.size() == 3 && ndi_obj_count == base_count);
+    EXPECT_FALSE (objs[0].is_created_in_ndi ());
+
+    txn.commit ();
+    EXPECT_TRUE (txn.size() == 0 && ndi_obj_count == base_count + 12);
+    EXPECT_TRUE (objs[2].is_created_in_ndi ());
+
+    /* Failure on a later NPU undoes every change of the transaction */
+    derived_obj_t obj_mod {objs[0]};
+    obj_mod.set_attr2 (2);
+    derived_obj_t obj_new {&logical_switch};
+    obj_new.set_attr1 (1);
+    txn.add_modify (obj_mod, objs[0]);
+    txn.add_delete (objs[1]);
+    txn.add_create (obj_new);
+    simulate_ndi_fail = 2;
+    EXPECT_THROW (txn.commit (), nas::base_exception);
+    EXPECT_TRUE (txn.size() == 0 && ndi_obj_count == base_count + 12);
+    EXPECT_FALSE (obj_new.is_created_in_ndi ());
+
+    /* Objects are back to their state before the add and can be retried */
+    EXPECT_TRUE (obj_mod.is_attr_dirty (BASE_UT_ATTR2));
+    EXPECT_FALSE (obj_mod.set_attr_list ().contains (BASE_UT_ATTR2));
+    EXPECT_TRUE (obj_new.is_attr_dirty (BASE_UT_ATTR1));
+    EXPECT_TRUE (obj_new.set_attr_list ().empty ());
+    obj_new.commit_create (false);
+    EXPECT_TRUE (ndi_obj_count == base_count + 16);
+    obj_mod.commit_modify (objs[0], false);
+    EXPECT_TRUE (obj_mod.set_attr_list ().contains (BASE_UT_ATTR2));
+
+    /* Object is not in NDI before commit, modify or delete of it is rejected */
+    derived_obj_t obj_pending {&logical_switch};
+    obj_pending.set_attr1 (3);
+    txn.add_create (obj_pending);
+    EXPECT_THROW (txn.add_delete (obj_pending), nas::base_exception);
+    EXPECT_TRUE (txn.size() == 1);
+    txn.commit ();
+    EXPECT_TRUE (obj_pending.is_created_in_ndi ());
+
+    /* Object queued by another object's commit keeps its bookkeeping */
+    derived_obj_t obj_owner {&logical_switch};
+    obj_owner.set_attr1 (3);
+    obj_owner.set_dependent (&obj_pending);
+    txn.add_create (obj_owner);
+    EXPECT_TRUE (txn.size() == 2);
+    simulate_ndi_fail = 2;
+    EXPECT_THROW (txn.commit (), nas::base_exception);
+    EXPECT_TRUE (obj_pending.is_created_in_ndi ());
+    EXPECT_TRUE (obj_pending.set_attr_list ().contains (BASE_UT_ATTR1));
+    EXPECT_TRUE (obj_pending.npu_list ().size () == 4);
+    EXPECT_FALSE (obj_owner.is_created_in_ndi ());
+
+    /* Create failing after its push was queued leaves nothing queued */
+    derived_obj_t obj_late {&logical_switch};
+    obj_late.set_attr1 (3);
+    obj_late.set_dependent (&obj_pending);
+    obj_late.set_fail_after_create (true);
+    EXPECT_THROW (txn.add_create (obj_late), nas::base_exception);
+    EXPECT_TRUE (txn.size() == 0);
+    EXPECT_TRUE (obj_late.is_attr_dirty (BASE_UT_ATTR1));
+    EXPECT_TRUE (obj_late.set_attr_list ().empty ());
+
+    txn.add_delete (obj_pending);
+    txn.add_delete (obj_new);
+    for (auto& obj: objs) txn.add_delete (obj);
+    txn.commit ();
+    EXPECT_TRUE (ndi_obj_count == base_count);
+}
+
+TEST (nas_base_obj_test, txn_benchmark)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+    const size_t count = 1000;
+    ndi_quiet = true;
+
+    for (bool batched: {false, true}) {
+        std::vector<derived_obj_t> objs (count, derived_obj_t {&logical_switch});
+        for (auto& obj: objs) obj.set_attr1 (3);
+
+        auto start = std::chrono::steady_clock::now();
+        if (batched) {
+            nas::base_txn_t txn;
+            for (auto& obj: objs) txn.add_create (obj);
+            txn.commit ();
+        } else {
+            for (auto& obj: objs) obj.commit_create (false);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        if (batched) {
+            nas::base_txn_t txn;
+            for (auto& obj: objs) txn.add_delete (obj);
+            txn.commit ();
+        } else {
+            for (auto& obj: objs) obj.commit_delete (false);
+        }
+        auto end = std::chrono::steady_clock::now();
+        printf ("%s: create %zu objects %ld us, delete %ld us\r\n",
+                batched ? "Transaction" : "One by one", count,
+                (long) std::chrono::duration_cast<std::chrono::microseconds> (mid - start).count(),
+                (long) std::chrono::duration_cast<std::chrono::microseconds> (end - mid).count());
+    }
+    ndi_quiet = false;
+}
+
+TEST (nas_base_obj_test, async_commit_test)
+{
+    derived_switch_t& logical_switch = base_ut_get_switch(1);
+    for (npu_id_t npu = 0; npu < 4; npu++) logical_switch.add_npu (npu);
+    int base_count = ndi_obj_count;
+    ndi_delay_us = 5000;
+
+    for (size_t workers: {0, 4}) {
+        nas::base_ndi_set_commit_workers (workers);
+        std::vector<derived_obj_t> objs (4, derived_obj_t {&logical_switch});
+        std::vector<std::future<void>> done;
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& obj: objs) {
+            obj.set_attr1 (2);
+            done.push_back (nas::base_commit_create_async (obj, false));
+        }
+        for (auto& f: done) f.get ();
+        auto end = std::chrono::steady_clock::now();
+        printf ("Create 4 objects with %zu commit workers: %ld ms\r\n", workers,
+                (long) std::chrono::duration_cast<std::chrono::milliseconds> (end - start).count());
+        EXPECT_TRUE (ndi_obj_count == base_count + 16);
+
+        /* Commits with the same key run in the order queued */
+        derived_obj_t obj_mod {objs[0]};
+        obj_mod.set_attr2 (1);
+        auto modified = nas::base_commit_modify_async (obj_mod, objs[0], false,
+                                                       (uintptr_t) &objs[0]);
+        done.clear ();
+        for (auto& obj: objs) done.push_back (nas::base_commit_delete_async (obj, false,
+                                                                            (uintptr_t) &objs[0]));
+        EXPECT_TRUE (modified.get ().contains (BASE_UT_ATTR2));
+        for (auto& f: done) f.get ();
+        EXPECT_TRUE (ndi_obj_count == base_count);
+
+        /* Default key of a modify is the object it was copied from */
+        derived_obj_t obj_orig {&logical_switch};
+        obj_orig.set_attr1 (2);
+        nas::base_commit_create_async (obj_orig, false).get ();
+        derived_obj_t obj_copy {obj_orig};
+        obj_copy.set_attr2 (1);
+        int stale_count = ndi_stale_set_count;
+        auto copy_modified = nas::base_commit_modify_async (obj_copy, obj_orig, false);
+        auto deleted = nas::base_commit_delete_async (obj_orig, false);
+        copy_modified.get ();
+        deleted.get ();
+        EXPECT_TRUE (ndi_stale_set_count == stale_count);
+        EXPECT_TRUE (ndi_obj_count == base_count);
+    }
+
+    /* The future carries the commit failure */
+    derived_obj_t obj_fail {&logical_switch};
+    obj_fail.set_attr1 (2);
+    simulate_ndi_fail = 3;
+    auto failed = nas::base_commit_create_async (obj_fail, false);
+    EXPECT_THROW (failed.get (), nas::base_exception);
+    EXPECT_TRUE (ndi_obj_count == base_count);
+
+    ndi_delay_us = 0;
+    nas::base_ndi_set_commit_workers (0);
+}
+
 int main(int argc, char **argv) {
     derived_switch_t& logical_switch = base_ut_get_switch(0);
     logical_switch.add_npu (0);
@@ -21,6 +21,7 @@
  */
 
 #include "nas_base_ut_simple_derived_obj.h"
+#include "nas_base_ndi_utl.h"
 
 derived_obj_t&  derived_switch_t::get_ut_obj (nas_obj_id_t ut_obj_id)
 {
@@ -54,7 +55,7 @@ void derived_switch_t::change_ut_obj (derived_obj_t& ut_obj)
 // Example Object class implementation
 ////////////////// 
 derived_obj_t::derived_obj_t (derived_switch_t* switch_p)
-            : nas::base_obj_t (switch_p)
+            : nas::base_obj_t (switch_p, BASE_UT_ATTR1), _obj ()
 {}
 
 bool derived_obj_t::push_leaf_attr_to_npu (nas_attr_id_t attr_id,
@@ -91,12 +92,49 @@ bool derived_obj_t::push_leaf_attr_to_npu (nas_attr_id_t attr_id,
     return true;
 }
 
+bool derived_obj_t::push_leaf_attrs_to_npu (const nas::attr_list_t& attr_list,
+                                            npu_id_t npu_id)
+{
+    if (!_bulk_push) {
+        return nas::base_obj_t::push_leaf_attrs_to_npu (attr_list, npu_id);
+    }
+
+    // Single NDI call sets all attributes of the object
+    t_std_error rc = STD_ERR_OK;
+    if ((rc = ndi_ut_obj_attrs_set (npu_id, ndi_obj_id(npu_id), &_obj))
+        != STD_ERR_OK)
+    {
+        throw nas::base_exception {rc, __PRETTY_FUNCTION__,
+                                  std::string {"NDI Fail: Set Attrs in NPU "}
+                                 + std::to_string (npu_id)};
+    }
+    return true;
+}
+
+void derived_obj_t::rollback_leaf_attrs_in_npu (const nas::attr_list_t& attr_list,
+                                                npu_id_t npu_id)
+{
+    if (!_bulk_push) {
+        nas::base_obj_t::rollback_leaf_attrs_in_npu (attr_list, npu_id);
+        return;
+    }
+    push_leaf_attrs_to_npu (attr_list, npu_id);
+}
+
 void derived_obj_t::set_ndi_obj_id (npu_id_t npu_id,
                                     ndi_obj_id_t id)
 {
     _ndi_obj_ids [npu_id] = id;
 }
 
+// Parallel delete resets the IDs of different NPUs concurrently,
+// never insert so the other entries are left in place
+void derived_obj_t::reset_ndi_obj_id (npu_id_t npu_id)
+{
+    auto it = _ndi_obj_ids.find (npu_id);
+    if (it != _ndi_obj_ids.end ()) it->second = 0;
+}
+
 void derived_obj_t::set_attr1 (uint_t attr1)
 {
     if (attr1 > MAX_ATTR1_RANGE) {
@@ -127,6 +165,14 @@ void derived_obj_t::commit_create (bool rolling_back)
     }
 
     nas::base_obj_t::commit_create(rolling_back);
+
+    if (_dependent) {
+        nas::base_modify_obj_ndi (*_dependent, *_dependent, rolling_back);
+    }
+    if (_fail_after_create) {
+        throw nas::base_exception {NAS_BASE_E_PARAM, __PRETTY_FUNCTION__,
+            "Simulated failure after create"};
+    }
 }
 
 nas::attr_set_t derived_obj_t::commit_modify (base_obj_t& obj_old, bool rolling_back)
@@ -141,6 +187,37 @@ nas::attr_set_t derived_obj_t::commit_modify (base_obj_t& obj_old, bool rolling_
     return nas::base_obj_t::commit_modify(obj_old, rolling_back);
 }
 
+void derived_obj_t::push_non_leaf_attr_ndi (nas_attr_id_t non_leaf_attr_id,
+                                            nas::base_obj_t& obj_old,
+                                            nas::npu_set_t npu_list,
+                                            nas::rollback_trakr_t& r_trakr,
+                                            bool rolling_back)
+{
+    for (auto npu_id: npu_list) {
+        push_leaf_attr_to_npu (non_leaf_attr_id, npu_id);
+        if (!rolling_back) {
+            r_trakr.push_back ({nas::ROLLBK_MODIFY_ATTR, npu_id, {non_leaf_attr_id}});
+        }
+    }
+}
+
+bool derived_obj_t::attr_equal (nas_attr_id_t attr_id,
+                                const nas::base_obj_t& obj_old) const
+{
+    if (!_value_compare) return false;
+
+    auto& old = static_cast<const derived_obj_t&> (obj_old);
+    switch (attr_id)
+    {
+        case BASE_UT_ATTR1:
+            return _obj.attr1 == old._obj.attr1;
+        case BASE_UT_ATTR2:
+            return _obj.attr2 == old._obj.attr2;
+        default:
+            return false;
+    }
+}
+
 void* derived_obj_t::alloc_fill_ndi_obj (nas::mem_alloc_helper_t& mem_trakr)
 {
     ndi_ut_obj_t* ndi_ut_obj_p = mem_trakr.alloc<ndi_ut_obj_t> (1);
@@ -154,20 +231,28 @@ void* derived_obj_t::alloc_fill_ndi_obj (nas::mem_alloc_helper_t& mem_trakr)
 bool derived_obj_t::push_create_obj_to_npu (npu_id_t npu_id, void* ndi_obj)
 {
     ndi_obj_id_t ndi_ut_obj_id;
+
+    push_create_obj_to_npu_parallel (npu_id, ndi_obj, ndi_ut_obj_id);
+    // Cache the new Table ID generated by NDI
+    set_ndi_obj_id (npu_id, ndi_ut_obj_id);
+
+    return true;
+}
+
+bool derived_obj_t::push_create_obj_to_npu_parallel (npu_id_t npu_id, void* ndi_obj,
+                                                     ndi_obj_id_t& ndi_obj_id)
+{
     t_std_error rc;
 
     auto ndi_ut_obj_p = static_cast<ndi_ut_obj_t*> (ndi_obj);
 
-    if ((rc = ndi_ut_obj_create (npu_id, ndi_ut_obj_p, &ndi_ut_obj_id))
+    if ((rc = ndi_ut_obj_create (npu_id, ndi_ut_obj_p, &ndi_obj_id))
             != STD_ERR_OK)
     {
         throw nas::base_exception {rc, __PRETTY_FUNCTION__,
                        std::string {"NDI Fail: UT Obj Create Failed for NPU "}
                        + std::to_string (npu_id)};
     }
-    // Cache the new Table ID generated by NDI
-    set_ndi_obj_id (npu_id, ndi_ut_obj_id);
-
     return true;
 }
 
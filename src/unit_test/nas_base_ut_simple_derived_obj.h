@@ -69,15 +69,44 @@ class derived_obj_t: public nas::base_obj_t
         void set_attr2 (uint_t attr2);
         void set_ndi_obj_id (npu_id_t npu_id,
                              ndi_obj_id_t id);
-        void reset_ndi_obj_id (npu_id_t npu_id) {set_ndi_obj_id (npu_id, 0);}
+        void reset_ndi_obj_id (npu_id_t npu_id);
 
         void commit_create (bool rolling_back);
         nas::attr_set_t commit_modify (base_obj_t& obj_old, bool rolling_back);
 
         void* alloc_fill_ndi_obj (nas::mem_alloc_helper_t& mem_trakr);
         virtual bool push_create_obj_to_npu (npu_id_t npu, void* ndi_obj) override final;
+        virtual bool push_create_obj_to_npu_parallel (npu_id_t npu, void* ndi_obj,
+                                                      ndi_obj_id_t& ndi_obj_id) override final;
+        virtual void set_pushed_ndi_obj_id (npu_id_t npu,
+                                            ndi_obj_id_t ndi_obj_id) override final
+        {set_ndi_obj_id (npu, ndi_obj_id);}
         virtual bool push_delete_obj_to_npu (npu_id_t npu) override final;
         virtual bool push_leaf_attr_to_npu (nas_attr_id_t attr_id, npu_id_t npu) override final;
+        virtual bool push_leaf_attrs_to_npu (const nas::attr_list_t& attr_list,
+                                             npu_id_t npu) override final;
+        virtual void rollback_leaf_attrs_in_npu (const nas::attr_list_t& attr_list,
+                                                 npu_id_t npu) override final;
+
+        void set_push_parallel (bool parallel) {_push_parallel = parallel;}
+        virtual bool push_npus_in_parallel () const override final {return _push_parallel;}
+        void set_bulk_push (bool bulk) {_bulk_push = bulk;}
+        void set_value_compare (bool compare) {_value_compare = compare;}
+        // Push dependent object along with this one when it is created
+        void set_dependent (derived_obj_t* dependent) {_dependent = dependent;}
+        // Fail the create after its NDI push was done or queued
+        void set_fail_after_create (bool fail) {_fail_after_create = fail;}
+        // Treat attribute as non-leaf to exercise push_non_leaf_attr_ndi
+        void set_non_leaf_attr (nas_attr_id_t attr_id) {_non_leaf_attr = attr_id;}
+        virtual bool is_leaf_attr (nas_attr_id_t attr_id) override final
+        {return attr_id != _non_leaf_attr;}
+        virtual void push_non_leaf_attr_ndi (nas_attr_id_t non_leaf_attr_id,
+                                             nas::base_obj_t& obj_old,
+                                             nas::npu_set_t npu_list,
+                                             nas::rollback_trakr_t& r_trakr,
+                                             bool rolling_back) override final;
+        virtual bool attr_equal (nas_attr_id_t attr_id,
+                                 const nas::base_obj_t& obj_old) const override final;
 
     private:
         ndi_ut_obj_t  _obj;
@@ -89,6 +118,12 @@ class derived_obj_t: public nas::base_obj_t
         // List of mapped NDI IDs one for each NPU
         // managed by this NAS component
         ndi_obj_id_map_t          _ndi_obj_ids;
+        bool                      _push_parallel = false;
+        bool                      _bulk_push = false;
+        bool                      _value_compare = false;
+        nas_attr_id_t             _non_leaf_attr = 0;
+        derived_obj_t*            _dependent = nullptr;
+        bool                      _fail_after_create = false;
 };
 
 ///////////////////
@@ -119,3 +154,6 @@ t_std_error ndi_ut_obj_attr1_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
 
 t_std_error ndi_ut_obj_attr2_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
                                   uint_t attr_val);
+
+t_std_error ndi_ut_obj_attrs_set (npu_id_t npu_id, size_t ndi_ut_obj_id,
+                                  const ndi_ut_obj_t* ndi_ut_obj_p);
@@ -16,7 +16,15 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <stdlib.h>
+#include <string.h>
 #include "gtest/gtest.h"
 #include "std_bit_masks.h"
 #include "nas_base_utils.h"
@@ -83,6 +91,91 @@ TEST (nas_util_test, attr_set_and_mem_helper_test)
     printf ("\r\n");
 }
 
+TEST (nas_util_test, attr_set_window_test)
+{
+    /* Class attribute IDs in the window, stray IDs on both sides of it */
+    const nas_attr_id_t base = 0x20000;
+    nas::attr_set_t attrs (base);
+    std::vector<nas_attr_id_t> ids {5, base, base + 1, base + 63, base + 64,
+                                    base + 255, base + 256, base + 1000};
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+        attrs.add (*it);
+    }
+    attrs.add (base + 64);
+
+    ASSERT_TRUE (attrs.size() == ids.size());
+    ASSERT_TRUE (attrs.len() == base + 1000);
+    ASSERT_TRUE (std::equal (ids.begin(), ids.end(), attrs.begin()));
+    ASSERT_TRUE (attrs.contains (5) && attrs.contains (base + 255));
+    ASSERT_FALSE (attrs.contains (base + 2));
+
+    attrs.del (base + 63);
+    attrs.del (5);
+    ASSERT_FALSE (attrs.contains (base + 63) || attrs.contains (5));
+    ASSERT_TRUE (attrs.size() == ids.size() - 2);
+
+    /* Max ID follows deletes of the max from the sparse set and the window */
+    attrs.del (base + 1000);
+    ASSERT_TRUE (attrs.len() == base + 256);
+    attrs.del (base + 256);
+    ASSERT_TRUE (attrs.len() == base + 255);
+    attrs.del (base + 255);
+    ASSERT_TRUE (attrs.len() == base + 64);
+    attrs.add (base + 255);
+    attrs.add (base + 256);
+    attrs.add (base + 1000);
+
+    /* Same window is a word OR, different window is element-wise */
+    nas::attr_set_t same (base), other;
+    same.add (base + 2);
+    other.add (7);
+    attrs += same;
+    attrs += other;
+    std::vector<nas_attr_id_t> expect {7, base, base + 1, base + 2, base + 64,
+                                       base + 255, base + 256, base + 1000};
+    std::vector<nas_attr_id_t> got (attrs.begin(), attrs.end());
+    ASSERT_TRUE (got == expect);
+
+    nas_attr_id_t arr[8];
+    attrs.to_array (arr, 8);
+    ASSERT_TRUE (std::equal (expect.begin(), expect.end(), arr));
+
+    attrs.clear ();
+    ASSERT_TRUE (attrs.empty() && attrs.begin() == attrs.end());
+}
+
+TEST (nas_util_test, mem_helper_arena_test)
+{
+    struct alignas (32) wide_t { char c[40]; };
+    nas::mem_alloc_helper_t m_helper;
+    std::vector<std::pair<uint8_t*, size_t>> allocs;
+
+    /* Spill past the inline block into several overflow blocks */
+    for (size_t i = 0; i < 2000; i++) {
+        size_t count = 1 + (i % 37);
+        auto p = m_helper.alloc<uint8_t> (count);
+        for (size_t j = 0; j < count; j++) ASSERT_TRUE (p[j] == 0);
+        memset (p, (int) (i & 0xff), count);
+        allocs.emplace_back (p, i);
+        auto w = m_helper.alloc<wide_t> (1);
+        ASSERT_TRUE (((uintptr_t) w % alignof (wide_t)) == 0);
+        auto u = m_helper.alloc<uint64_t> (3);
+        ASSERT_TRUE (((uintptr_t) u % alignof (uint64_t)) == 0);
+        ASSERT_TRUE (u[0] == 0 && u[2] == 0);
+    }
+    /* Larger than any block so far */
+    auto big = m_helper.alloc<uint32_t> (1 << 20);
+    ASSERT_TRUE (big[0] == 0 && big[(1 << 20) - 1] == 0);
+
+    for (auto& a: allocs) {
+        for (size_t j = 0; j < 1 + (a.second % 37); j++) {
+            ASSERT_TRUE (a.first[j] == (uint8_t) (a.second & 0xff));
+        }
+    }
+
+    m_helper.add (malloc (16));
+}
+
 TEST (nas_util_test, npu_set_test)
 {
     nas::npu_set_t npus1;
@@ -136,6 +229,37 @@ TEST (nas_util_test, npu_set_test)
     std::cout << str << std::endl;
 }
 
+TEST (nas_util_test, npu_set_overflow_test)
+{
+    /* NPUs past the inline mask go to the overflow set */
+    const npu_id_t big = nas::npu_set_t::INLINE_BITS + 5;
+    nas::npu_set_t npus1, npus2;
+    for (npu_id_t npu: {0, 63, 64, 127, big}) npus1.add (npu);
+    for (npu_id_t npu: {1, 63, 127, big + 1}) npus2.add (npu);
+
+    ASSERT_TRUE (npus1.size() == 5 && npus1.contains (big));
+    std::vector<npu_id_t> got (npus1.begin(), npus1.end());
+    ASSERT_TRUE ((got == std::vector<npu_id_t>{0, 63, 64, 127, big}));
+
+    nas::npu_set_t npus_mine, npus_second, npus_both;
+    npus1.compare (npus2, npus_mine, npus_second, npus_both);
+    got.assign (npus_mine.begin(), npus_mine.end());
+    ASSERT_TRUE ((got == std::vector<npu_id_t>{0, 64, big}));
+    got.assign (npus_second.begin(), npus_second.end());
+    ASSERT_TRUE ((got == std::vector<npu_id_t>{1, big + 1}));
+    got.assign (npus_both.begin(), npus_both.end());
+    ASSERT_TRUE ((got == std::vector<npu_id_t>{63, 127}));
+
+    nas::npu_set_t copy = npus1;
+    ASSERT_TRUE (copy == npus1 && copy != npus2);
+    copy.del (big);
+    copy.del (64);
+    ASSERT_FALSE (copy.contains (big) || copy.contains (64));
+    ASSERT_TRUE (copy != npus1 && copy.size() == 3);
+    copy.clear ();
+    ASSERT_TRUE (copy.empty() && copy.begin() == copy.end());
+}
+
 TEST (nas_util_test, id_gen_test)
 {
     for (size_t max_id=6; max_id<=18; max_id++)
@@ -182,6 +306,249 @@ TEST (nas_util_test, id_gen_test)
     }
 }
 
+TEST (nas_util_test, id_gen_bulk_test)
+{
+    const size_t max_id = 5000;
+    nas::id_generator_t id_gen{max_id};
+    ASSERT_TRUE (id_gen.free_count() == max_id);
+
+    std::vector<nas_obj_id_t> ids;
+    id_gen.alloc_ids (130, ids);
+    ASSERT_TRUE (ids.size() == 130 && ids.front() == 1 && ids.back() == 130);
+    ASSERT_TRUE (id_gen.free_count() == max_id - 130);
+
+    /* Punch holes so that a range has to skip them */
+    for (nas_obj_id_t id = 2; id <= 128; id += 2) id_gen.release_id (id);
+    ASSERT_TRUE (id_gen.alloc_range (100) == 131);
+    ASSERT_TRUE (id_gen.alloc_id () == 231);
+
+    /* Range search wraps to the start once the end is used up */
+    nas_obj_id_t last = id_gen.alloc_range (max_id - 231);
+    ASSERT_TRUE (last == 232);
+    ASSERT_TRUE (id_gen.free_count() == 64);
+    try {
+        id_gen.alloc_range (2);
+        ASSERT_TRUE (0);
+    } catch (nas::base_exception& e) {
+    }
+    ids.clear ();
+    try {
+        id_gen.alloc_ids (65, ids);
+        ASSERT_TRUE (0);
+    } catch (nas::base_exception& e) {
+    }
+    ASSERT_TRUE (ids.empty() && id_gen.free_count() == 64);
+    id_gen.alloc_ids (64, ids);
+    for (size_t i = 0; i < ids.size(); i++) ASSERT_TRUE (ids[i] == 2 + 2 * i);
+    ASSERT_TRUE (id_gen.free_count() == 0);
+
+    id_gen.release_id (4000);
+    id_gen.release_id (4001);
+    ASSERT_TRUE (id_gen.alloc_range (2) == 4000);
+
+    /* Random churn checked against a reference set */
+    nas::id_generator_t gen2{max_id};
+    std::set<nas_obj_id_t> used;
+    srand (1);
+    for (size_t i = 0; i < 20000; i++) {
+        if (used.size() < max_id && (rand() % 3 != 0)) {
+            auto id = gen2.alloc_id ();
+            ASSERT_TRUE (id >= 1 && id <= max_id && used.insert (id).second);
+        } else if (!used.empty()) {
+            auto it = used.begin();
+            std::advance (it, rand() % used.size());
+            gen2.release_id (*it);
+            used.erase (it);
+        }
+        ASSERT_TRUE (gen2.free_count() == max_id - used.size());
+    }
+    nas::id_generator_t moved = std::move (gen2);
+    ASSERT_TRUE (moved.free_count() == max_id - used.size());
+}
+
+TEST (nas_util_test, id_gen_benchmark)
+{
+    const size_t max_id = 1 << 20;
+    nas::id_generator_t id_gen{max_id};
+    std::vector<nas_obj_id_t> ids;
+
+    /* 99.9% occupancy, free IDs scattered over the space */
+    id_gen.alloc_ids (max_id, ids);
+    srand (2);
+    while (id_gen.free_count() < max_id / 1000) {
+        nas_obj_id_t id = 1 + rand() % max_id;
+        id_gen.release_id (id);
+    }
+
+    const size_t loops = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loops; i++) {
+        auto id = id_gen.alloc_id ();
+        id_gen.release_id (1 + (id * 7919) % max_id);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf ("alloc/release at 99.9%% occupancy: %.1f ns/op\n",
+            std::chrono::duration<double, std::nano> (end - start).count() / loops);
+
+    ids.clear ();
+    start = std::chrono::steady_clock::now();
+    id_gen.alloc_ids (id_gen.free_count() / 2, ids);
+    end = std::chrono::steady_clock::now();
+    printf ("alloc_ids of %zu IDs: %.1f ns/ID\n", ids.size(),
+            std::chrono::duration<double, std::nano> (end - start).count() / ids.size());
+}
+
+TEST (nas_util_test, id_gen_snapshot_test)
+{
+    const size_t max_id = 1 << 20;
+    nas::id_generator_t id_gen{max_id};
+    std::vector<nas_obj_id_t> ids;
+    id_gen.alloc_ids (300000, ids);
+    for (nas_obj_id_t id = 500000; id < 600000; id += 3) id_gen.reserve_id (id);
+    id_gen.release_id (17);
+
+    std::vector<uint8_t> raw, rle;
+    id_gen.snapshot (raw);
+    id_gen.snapshot (rle, true);
+    printf ("Snapshot of %zu IDs: raw %zu bytes, RLE %zu bytes\n", max_id, raw.size(), rle.size());
+    ASSERT_TRUE (rle.size() < raw.size());
+
+    /* Restore versus replaying every used ID */
+    for (auto blob: {&raw, &rle}) {
+        nas::id_generator_t restored{max_id};
+        auto start = std::chrono::steady_clock::now();
+        restored.restore (blob->data(), blob->size());
+        auto end = std::chrono::steady_clock::now();
+        printf ("%s restore: %.0f us\n", blob == &raw ? "raw" : "RLE",
+                std::chrono::duration<double, std::micro> (end - start).count());
+        ASSERT_TRUE (restored.free_count() == id_gen.free_count());
+        ASSERT_TRUE (restored.alloc_id () == 17);
+        ASSERT_FALSE (restored.reserve_id (500003));
+        ASSERT_TRUE (restored.reserve_id (500001));
+    }
+    nas::id_generator_t replayed{max_id};
+    auto start = std::chrono::steady_clock::now();
+    for (nas_obj_id_t id = 1; id <= max_id; id++) {
+        if (!id_gen.reserve_id (id)) replayed.reserve_id (id);
+        else id_gen.release_id (id);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf ("reserve_id replay: %.0f us\n",
+            std::chrono::duration<double, std::micro> (end - start).count());
+    ASSERT_TRUE (replayed.free_count() == id_gen.free_count());
+
+    /* Corrupt or mismatched snapshots leave the state untouched */
+    nas::id_generator_t target{max_id};
+    std::vector<uint8_t> bad = rle;
+    bad.back() ^= 1;
+    nas::id_generator_t small{1000};
+    for (auto attempt: {0, 1, 2}) {
+        try {
+            if (attempt == 0) target.restore (bad.data(), bad.size());
+            if (attempt == 1) target.restore (raw.data(), raw.size() - 8);
+            if (attempt == 2) small.restore (raw.data(), raw.size());
+            ASSERT_TRUE (0);
+        } catch (nas::base_exception& e) {
+            printf ("%s\n", e.err_msg.c_str());
+        }
+    }
+    ASSERT_TRUE (target.free_count() == max_id && small.free_count() == 1000);
+}
+
+TEST (nas_util_test, concurrent_id_gen_test)
+{
+    const size_t max_id = 100000;
+    nas::concurrent_id_generator_t id_gen{max_id};
+    ASSERT_TRUE (id_gen.reserve_id (max_id));
+    ASSERT_FALSE (id_gen.reserve_id (max_id));
+    ASSERT_FALSE (id_gen.reserve_id (max_id + 1));
+    ASSERT_FALSE (id_gen.reserve_id (0));
+    id_gen.release_id (max_id);
+
+    /* Threads drain the ID space together, every ID handed out once */
+    const size_t threads = 8;
+    std::vector<std::vector<nas_obj_id_t>> got (threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back ([&, t]() {
+            try {
+                for (size_t i = 0; ; i++) {
+                    auto id = id_gen.alloc_id ();
+                    got[t].push_back (id);
+                    /* Churn some of them back */
+                    if (i % 4 == 0) {
+                        id_gen.release_id (id);
+                        got[t].pop_back ();
+                    }
+                }
+            } catch (nas::base_exception& e) {
+            }
+        });
+    }
+    for (auto& w: workers) w.join ();
+
+    std::vector<bool> seen (max_id + 1, false);
+    size_t total = 0;
+    for (auto& ids: got) {
+        for (auto id: ids) {
+            ASSERT_TRUE (id >= 1 && id <= max_id && !seen[id]);
+            seen[id] = true;
+            total++;
+        }
+    }
+    ASSERT_TRUE (total == max_id && id_gen.free_count() == 0);
+
+    id_gen.release_id (77);
+    ASSERT_TRUE (id_gen.free_count() == 1 && id_gen.alloc_id () == 77);
+}
+
+TEST (nas_util_test, concurrent_id_gen_benchmark)
+{
+    const size_t max_id = 1 << 20;
+    nas::concurrent_id_generator_t lock_free{max_id};
+    nas::id_generator_t locked{max_id};
+    std::mutex lock;
+
+    for (size_t threads = 1; threads <= 16; threads *= 2) {
+        for (int variant = 0; variant < 2; variant++) {
+            std::atomic<bool> done{false};
+            std::atomic<size_t> total{0};
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; t++) {
+                workers.emplace_back ([&, variant]() {
+                    size_t count = 0;
+                    nas_obj_id_t held[16];
+                    while (!done.load (std::memory_order_relaxed)) {
+                        for (auto& id: held) {
+                            if (variant == 0) {
+                                id = lock_free.alloc_id ();
+                            } else {
+                                std::lock_guard<std::mutex> l {lock};
+                                id = locked.alloc_id ();
+                            }
+                        }
+                        for (auto id: held) {
+                            if (variant == 0) {
+                                lock_free.release_id (id);
+                            } else {
+                                std::lock_guard<std::mutex> l {lock};
+                                locked.release_id (id);
+                            }
+                        }
+                        count += 16;
+                    }
+                    total += count;
+                });
+            }
+            std::this_thread::sleep_for (std::chrono::milliseconds (100));
+            done = true;
+            for (auto& w: workers) w.join ();
+            printf ("%2zu threads %-10s: %12.0f alloc+release/sec\n", threads,
+                    variant == 0 ? "lock-free" : "mutex", total / 0.1);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
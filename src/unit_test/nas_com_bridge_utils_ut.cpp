@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include "nas_com_bridge_utils.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(nas_com_bridge_utils, untag_vid)
+{
+    hal_vlan_id_t vid = 0;
+    char name[32];
+
+    ASSERT_FALSE(nas_com_get_1d_br_untag_vid("br1", vid) == STD_ERR_OK);
+    ASSERT_TRUE(nas_com_add_1d_br_untag_vid("br1", 100) == STD_ERR_OK);
+    ASSERT_FALSE(nas_com_add_1d_br_untag_vid("br1", 101) == STD_ERR_OK);
+    ASSERT_TRUE(nas_com_get_1d_br_untag_vid("br1", vid) == STD_ERR_OK);
+    ASSERT_TRUE(vid == 100);
+
+    /* Enough bridges to grow the map several times */
+    for (int ix = 0; ix < 5000; ++ix) {
+        snprintf(name, sizeof(name), "vn%d", ix);
+        ASSERT_TRUE(nas_com_add_1d_br_untag_vid(name, 1 + ix % 4000) == STD_ERR_OK);
+    }
+    for (int ix = 0; ix < 5000; ++ix) {
+        snprintf(name, sizeof(name), "vn%d", ix);
+        ASSERT_TRUE(nas_com_get_1d_br_untag_vid(name, vid) == STD_ERR_OK);
+        ASSERT_TRUE(vid == 1 + ix % 4000);
+    }
+
+    /* Delete/add churn reuses deleted slots */
+    for (int loop = 0; loop < 20; ++loop) {
+        for (int ix = 0; ix < 5000; ix += 2) {
+            snprintf(name, sizeof(name), "vn%d", ix);
+            ASSERT_TRUE(nas_com_del_1d_br_untag_vid(name) == STD_ERR_OK);
+        }
+        for (int ix = 0; ix < 5000; ix += 2) {
+            snprintf(name, sizeof(name), "vn%d", ix);
+            ASSERT_TRUE(nas_com_add_1d_br_untag_vid(name, 1 + ix % 4000) == STD_ERR_OK);
+        }
+    }
+    for (int ix = 0; ix < 5000; ++ix) {
+        snprintf(name, sizeof(name), "vn%d", ix);
+        ASSERT_TRUE(nas_com_get_1d_br_untag_vid(name, vid) == STD_ERR_OK);
+        ASSERT_TRUE(vid == 1 + ix % 4000);
+        ASSERT_TRUE(nas_com_del_1d_br_untag_vid(name) == STD_ERR_OK);
+    }
+    ASSERT_FALSE(nas_com_del_1d_br_untag_vid("vn0") == STD_ERR_OK);
+
+    /* Reserved VLAN id is returned for bridges not in the map */
+    ASSERT_TRUE(nas_com_set_1d_br_reserved_vid(4094) == STD_ERR_OK);
+    ASSERT_TRUE(nas_com_get_1d_br_untag_vid("vn0", vid) == STD_ERR_OK);
+    ASSERT_TRUE(vid == 4094);
+    ASSERT_TRUE(nas_com_set_1d_br_reserved_vid(0) == STD_ERR_OK);
+    ASSERT_TRUE(nas_com_del_1d_br_untag_vid("br1") == STD_ERR_OK);
+}
+
+TEST(nas_com_bridge_utils, concurrent_lookup)
+{
+    ASSERT_TRUE(nas_com_add_1d_br_untag_vid("stable", 200) == STD_ERR_OK);
+    std::atomic<bool> done{false};
+    std::atomic<size_t> misses{0};
+    std::vector<std::thread> readers;
+    for (int ix = 0; ix < 4; ++ix) {
+        readers.emplace_back([&]() {
+            hal_vlan_id_t vid;
+            while (!done) {
+                if (nas_com_get_1d_br_untag_vid("stable", vid) != STD_ERR_OK || vid != 200) {
+                    ++misses;
+                }
+            }
+        });
+    }
+    char name[32];
+    for (int loop = 0; loop < 10; ++loop) {
+        for (int ix = 0; ix < 1000; ++ix) {
+            snprintf(name, sizeof(name), "churn%d", ix);
+            nas_com_add_1d_br_untag_vid(name, 300);
+        }
+        for (int ix = 0; ix < 1000; ++ix) {
+            snprintf(name, sizeof(name), "churn%d", ix);
+            nas_com_del_1d_br_untag_vid(name);
+        }
+    }
+    done = true;
+    for (auto &t : readers) t.join();
+    ASSERT_TRUE(misses == 0);
+    ASSERT_TRUE(nas_com_del_1d_br_untag_vid("stable") == STD_ERR_OK);
+}
+
+TEST(nas_com_bridge_utils, reverse_and_bulk)
+{
+    const size_t count = 3000;
+    std::vector<std::string> names;
+    std::vector<nas_com_br_untag_vid_t> entries(count);
+    for (size_t ix = 0; ix < count; ++ix) {
+        names.push_back("vni" + std::to_string(ix));
+    }
+    for (size_t ix = 0; ix < count; ++ix) {
+        entries[ix].br_name = names[ix].c_str();
+        entries[ix].vlan_id = 10 + ix % 100;
+    }
+    ASSERT_TRUE(nas_com_add_1d_br_untag_vid_bulk(entries.data(), count) == STD_ERR_OK);
+
+    std::vector<std::string> brs;
+    ASSERT_TRUE(nas_com_get_1d_br_by_untag_vid(10, brs) == STD_ERR_OK);
+    ASSERT_TRUE(brs.size() == count / 100);
+    ASSERT_FALSE(nas_com_get_1d_br_by_untag_vid(9, brs) == STD_ERR_OK);
+
+    /* Second add fails per entry, the first entry is new */
+    ASSERT_TRUE(nas_com_del_1d_br_untag_vid("vni0") == STD_ERR_OK);
+    ASSERT_FALSE(nas_com_add_1d_br_untag_vid_bulk(entries.data(), count) == STD_ERR_OK);
+    ASSERT_TRUE(entries[0].rc == STD_ERR_OK);
+    ASSERT_FALSE(entries[1].rc == STD_ERR_OK);
+
+    for (auto &e : entries) e.vlan_id = 0;
+    ASSERT_TRUE(nas_com_get_1d_br_untag_vid_bulk(entries.data(), count) == STD_ERR_OK);
+    for (size_t ix = 0; ix < count; ++ix) {
+        ASSERT_TRUE(entries[ix].vlan_id == 10 + ix % 100);
+    }
+
+    ASSERT_TRUE(nas_com_del_1d_br_untag_vid_bulk(entries.data(), count) == STD_ERR_OK);
+    brs.clear();
+    ASSERT_FALSE(nas_com_get_1d_br_by_untag_vid(10, brs) == STD_ERR_OK);
+    ASSERT_FALSE(nas_com_get_1d_br_untag_vid_bulk(entries.data(), 1) == STD_ERR_OK);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
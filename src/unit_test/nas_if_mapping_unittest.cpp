@@ -23,6 +23,8 @@
 
 
 #include "hal_if_mapping.h"
+#include "hal_if_shm.h"
+#include "hal_if_trace.h"
 #include "std_utils.h"
 
 #include <gtest/gtest.h>
@@ -30,6 +32,10 @@
 #include <iostream>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
 
 
 TEST(nas_if_mapping, npu_port) {
@@ -164,6 +170,328 @@ TEST(nas_if_mapping, get_next_ifindex) {
     } while(ret == STD_ERR_OK);
 }
 
+TEST(nas_if_mapping, get_next_intf_by_type) {
+    interface_ctrl_t r;
+    hal_ifindex_t lag_ifindexes[] = {5003, 5001, 5002};
+
+    for (auto ifindex: lag_ifindexes) {
+        memset(&r,0,sizeof(r));
+        r.int_type = nas_int_type_LAG;
+        r.lag_id = ifindex;
+        r.if_index = ifindex;
+        r.vrf_id = 0;
+        snprintf(r.if_name,sizeof(r.if_name),"bond%d",(int)ifindex);
+        ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    }
+
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_VLAN;
+    r.vlan_id = 100;
+    r.if_index = 5004;
+    safestrncpy(r.if_name,"br100",sizeof(r.if_name));
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+
+    hal_ifindex_t expected = 5001;
+    hal_ifindex_t *current_ifindex = nullptr;
+    hal_ifindex_t ifindex;
+    while (dn_hal_get_next_intf_by_type(nas_int_type_LAG, 0, current_ifindex, &r)==STD_ERR_OK) {
+        ASSERT_TRUE(r.int_type == nas_int_type_LAG);
+        ASSERT_TRUE(r.if_index == expected);
+        ASSERT_TRUE(r.lag_id == (lag_id_t)expected);
+        ++expected;
+        ifindex = r.if_index;
+        current_ifindex = &ifindex;
+    }
+    ASSERT_TRUE(expected == 5004);
+
+    ASSERT_FALSE(dn_hal_get_next_intf_by_type(nas_int_type_LAG, 1, nullptr, &r)==STD_ERR_OK);
+
+    ifindex = 5002;
+    hal_ifindex_t next_ifindex;
+    ASSERT_TRUE(dn_hal_get_next_ifindex(&ifindex, &next_ifindex)==STD_ERR_OK);
+    ASSERT_TRUE(next_ifindex == 5003);
+
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_LAG;
+    r.if_index = 5002;
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+
+    ifindex = 5001;
+    ASSERT_TRUE(dn_hal_get_next_intf_by_type(nas_int_type_LAG, 0, &ifindex, &r)==STD_ERR_OK);
+    ASSERT_TRUE(r.if_index == 5003);
+    ASSERT_TRUE(dn_hal_get_next_ifindex(&ifindex, &next_ifindex)==STD_ERR_OK);
+    ASSERT_TRUE(next_ifindex == 5003);
+}
+
+static bool _count_ports(const interface_ctrl_t *p, void *context) {
+    auto last_port = (npu_port_t *)context;
+    EXPECT_TRUE(p->port_id > *last_port);
+    *last_port = p->port_id;
+    return true;
+}
+
+TEST(nas_if_mapping, npu_ports) {
+    interface_ctrl_t r;
+    npu_port_t ports[] = {9, 3, 7, 1};
+
+    for (auto port: ports) {
+        memset(&r,0,sizeof(r));
+        r.int_type = nas_int_type_PORT;
+        r.port_mapped = true;
+        r.npu_id = 7;
+        r.port_id = port;
+        r.if_index = 6000 + port;
+        r.tap_id = 6000 + port;
+        snprintf(r.if_name,sizeof(r.if_name),"npu7-e%d",(int)port);
+        ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    }
+    ASSERT_TRUE(dn_hal_get_npu_port_count(7) == 4);
+    ASSERT_TRUE(dn_hal_get_npu_port_count(8) == 0);
+
+    npu_port_t expected[] = {1, 3, 7, 9};
+    size_t ix = 0;
+    npu_port_t *current_port = nullptr;
+    npu_port_t port;
+    while (dn_hal_get_next_npu_port_intf(7, current_port, &r)==STD_ERR_OK) {
+        ASSERT_TRUE(ix < 4);
+        ASSERT_TRUE(r.port_id == expected[ix++]);
+        ASSERT_TRUE(r.if_index == 6000 + r.port_id);
+        port = r.port_id;
+        current_port = &port;
+    }
+    ASSERT_TRUE(ix == 4);
+
+    npu_port_t last_port = -1;
+    ASSERT_TRUE(dn_hal_walk_npu_ports(7, _count_ports, &last_port) == 4);
+    ASSERT_TRUE(last_port == 9);
+
+    memset(&r,0,sizeof(r));
+    r.if_index = 6003;
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_get_npu_port_count(7) == 3);
+
+    port = 1;
+    ASSERT_TRUE(dn_hal_get_next_npu_port_intf(7, &port, &r)==STD_ERR_OK);
+    ASSERT_TRUE(r.port_id == 7);
+}
+
+TEST(nas_if_mapping, change_journal) {
+    uint64_t seq = dn_hal_get_change_seq();
+
+    interface_ctrl_t r;
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_LPBK;
+    r.if_index = 7001;
+    safestrncpy(r.if_name,"lo1",sizeof(r.if_name));
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_update_intf_mac(7001, "00:11:22:33:44:55")==STD_ERR_OK);
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+
+    hal_intf_change_t changes[2];
+    size_t count = 2;
+    uint64_t last_seq = 0;
+    ASSERT_TRUE(dn_hal_get_changes_since(seq, changes, &count, &last_seq)==STD_ERR_OK);
+    ASSERT_TRUE(last_seq == seq + 3);
+    ASSERT_TRUE(count == 2);
+    ASSERT_TRUE(changes[0].seq == seq + 1 && changes[0].change == HAL_INTF_CHANGE_REG);
+    ASSERT_TRUE(changes[1].change == HAL_INTF_CHANGE_MAC && changes[1].if_index == 7001);
+
+    count = 2;
+    ASSERT_TRUE(dn_hal_get_changes_since(changes[1].seq, changes, &count, &last_seq)==STD_ERR_OK);
+    ASSERT_TRUE(count == 1);
+    ASSERT_TRUE(changes[0].change == HAL_INTF_CHANGE_DEREG);
+
+    count = 2;
+    ASSERT_TRUE(dn_hal_get_changes_since(last_seq, changes, &count, &last_seq)==STD_ERR_OK);
+    ASSERT_TRUE(count == 0);
+
+    /* Overflow the journal, the caller has to fall back to a snapshot */
+    seq = last_seq;
+    for (size_t ix = 0; ix < 5000; ++ix) {
+        ASSERT_TRUE(dn_hal_update_intf_mac(1, "00:11:22:33:44:55")==STD_ERR_OK);
+    }
+    count = 2;
+    ASSERT_FALSE(dn_hal_get_changes_since(seq, changes, &count, &last_seq)==STD_ERR_OK);
+
+    size_t total = 0;
+    uint64_t snapshot_seq = 0;
+    dn_hal_walk_interfaces([](const interface_ctrl_t *, void *ctx) {
+                               ++*(size_t *)ctx; return true; }, &total, &snapshot_seq);
+    ASSERT_TRUE(total > 0);
+    ASSERT_TRUE(snapshot_seq == last_seq);
+}
+
+TEST(nas_if_mapping, shm_db) {
+    hal_if_shm_handle_t owner, reader;
+    ASSERT_TRUE(dn_hal_shm_create("/nas_if_mapping_ut", 2048, &owner)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_attach("/nas_if_mapping_ut", &reader)==STD_ERR_OK);
+
+    interface_ctrl_t r;
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_VLAN;
+    r.vlan_id = 200;
+    r.if_index = 8001;
+    safestrncpy(r.if_name,"br200",sizeof(r.if_name));
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_update_intf_desc(&r, "uplink vlan")==STD_ERR_OK);
+
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_VLAN;
+    r.vlan_id = 200;
+    r.q_type = HAL_INTF_INFO_FROM_VLAN;
+    ASSERT_FALSE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+
+    ASSERT_TRUE(dn_hal_shm_publish(owner)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_get_change_seq(reader) == dn_hal_get_change_seq());
+    ASSERT_TRUE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+    ASSERT_TRUE(r.if_index == 8001);
+    ASSERT_TRUE(r.desc == nullptr);
+
+    char desc[MAX_INTF_DESC_LEN + 1];
+    ASSERT_TRUE(dn_hal_shm_get_intf_desc(reader, 0, 8001, desc, sizeof(desc))==STD_ERR_OK);
+    ASSERT_TRUE(strcmp(desc, "uplink vlan") == 0);
+
+    memset(&r,0,sizeof(r));
+    safestrncpy(r.if_name,"cliff5",sizeof(r.if_name));
+    r.q_type = HAL_INTF_INFO_FROM_IF_NAME;
+    ASSERT_TRUE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+    ASSERT_TRUE(r.if_index == 6);
+
+    memset(&r,0,sizeof(r));
+    r.port_id = 9;
+    r.npu_id = 7;
+    r.q_type = HAL_INTF_INFO_FROM_PORT;
+    ASSERT_TRUE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+    ASSERT_TRUE(r.if_index == 6009);
+
+    memset(&r,0,sizeof(r));
+    r.if_index = 8001;
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_publish(owner)==STD_ERR_OK);
+    ASSERT_FALSE(dn_hal_shm_get_interface_info(reader, &r)==STD_ERR_OK);
+
+    dn_hal_shm_close(reader);
+    dn_hal_shm_close(owner);
+}
+
+TEST(nas_if_mapping, shm_concurrent_publish) {
+    hal_if_shm_handle_t owner, reader;
+    ASSERT_TRUE(dn_hal_shm_create("/nas_if_mapping_ut", 2048, &owner)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_attach("/nas_if_mapping_ut", &reader)==STD_ERR_OK);
+
+    interface_ctrl_t r;
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_LPBK;
+    r.if_index = 8200;
+    safestrncpy(r.if_name,"stable",sizeof(r.if_name));
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_shm_publish(owner)==STD_ERR_OK);
+
+    /* Every publish rewrites both copies in turn while the reader is in them */
+    std::atomic<bool> done{false};
+    std::atomic<size_t> torn{0};
+    std::thread rd([&]() {
+        while (!done) {
+            interface_ctrl_t q;
+            memset(&q,0,sizeof(q));
+            q.if_index = 8200;
+            q.q_type = HAL_INTF_INFO_FROM_IF;
+            if (dn_hal_shm_get_interface_info(reader, &q)==STD_ERR_OK &&
+                strcmp(q.if_name, "stable") != 0) {
+                ++torn;
+            }
+        }
+    });
+    for (int ix = 0; ix < 2000; ++ix) {
+        memset(&r,0,sizeof(r));
+        r.int_type = nas_int_type_LPBK;
+        r.if_index = 8300 + ix % 100;
+        snprintf(r.if_name, sizeof(r.if_name), "churn%d", ix % 100);
+        r.q_type = HAL_INTF_INFO_FROM_IF;
+        if (ix >= 100) dn_hal_if_register(HAL_INTF_OP_DEREG,&r);
+        ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+        ASSERT_TRUE(dn_hal_shm_publish(owner)==STD_ERR_OK);
+    }
+    done = true;
+    rd.join();
+    ASSERT_TRUE(torn == 0);
+
+    for (int ix = 0; ix < 100; ++ix) {
+        memset(&r,0,sizeof(r));
+        r.if_index = 8300 + ix;
+        r.q_type = HAL_INTF_INFO_FROM_IF;
+        dn_hal_if_register(HAL_INTF_OP_DEREG,&r);
+    }
+    memset(&r,0,sizeof(r));
+    r.if_index = 8200;
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+
+    dn_hal_shm_close(reader);
+    dn_hal_shm_close(owner);
+}
+
+TEST(nas_if_mapping, trace) {
+    const char *path = "/tmp/nas_if_mapping_ut.trace";
+    ASSERT_TRUE(dn_hal_trace_start(path)==STD_ERR_OK);
+
+    interface_ctrl_t r;
+    memset(&r,0,sizeof(r));
+    r.int_type = nas_int_type_LAG;
+    r.lag_id = 77;
+    r.if_index = 8100;
+    safestrncpy(r.if_name,"bond77",sizeof(r.if_name));
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_REG,&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_update_intf_mac(8100, "00:11:22:33:44:55")==STD_ERR_OK);
+    r.q_type = HAL_INTF_INFO_FROM_IF;
+    ASSERT_TRUE(dn_hal_get_interface_info(&r)==STD_ERR_OK);
+    ASSERT_TRUE(dn_hal_if_register(HAL_INTF_OP_DEREG,&r)==STD_ERR_OK);
+    dn_hal_trace_stop();
+    /* Not recorded once stopped */
+    ASSERT_FALSE(dn_hal_get_interface_info(&r)==STD_ERR_OK);
+
+    FILE *fp = fopen(path, "rb");
+    ASSERT_TRUE(fp != nullptr);
+    hal_if_trace_file_hdr_t hdr;
+    ASSERT_TRUE(fread(&hdr, sizeof(hdr), 1, fp) == 1);
+    ASSERT_TRUE(hdr.magic == HAL_IF_TRACE_MAGIC);
+
+    const uint8_t expected[] = { HAL_IF_TRACE_OP_REG, HAL_IF_TRACE_OP_UPD_MAC,
+                                 HAL_IF_TRACE_OP_GET, HAL_IF_TRACE_OP_DEREG };
+    hal_if_trace_rec_t rec;
+    char buf[MAX_INTF_DESC_LEN];
+    size_t ix = 0;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        ASSERT_TRUE(ix < sizeof(expected));
+        ASSERT_TRUE(rec.op == expected[ix]);
+        ASSERT_TRUE(rec.if_index == 8100);
+        if (rec.name_len > 0) {
+            ASSERT_TRUE(fread(buf, rec.name_len, 1, fp) == 1);
+        }
+        if (rec.data_len > 0) {
+            ASSERT_TRUE(fread(buf, rec.data_len, 1, fp) == 1);
+        }
+        if (rec.op == HAL_IF_TRACE_OP_REG) {
+            lag_id_t lag_id;
+            memcpy(&lag_id, rec.ids, sizeof(lag_id));
+            ASSERT_TRUE(lag_id == 77);
+        }
+        if (rec.op == HAL_IF_TRACE_OP_UPD_MAC) {
+            ASSERT_TRUE(rec.data_len == 17 && memcmp(buf, "00:11:22:33:44:55", 17) == 0);
+        }
+        ++ix;
+    }
+    ASSERT_TRUE(ix == sizeof(expected));
+    fclose(fp);
+    unlink(path);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -20,6 +20,8 @@
 #include <iostream>
 #include "nas_ndi_obj_id_table.h"
 #include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
 
 TEST(ndi_obj_id_map_test, cpluplus) {
     nas::ndi_obj_id_table_t  ndi_obj_ids;
@@ -70,6 +72,154 @@ TEST(ndi_obj_id_map_test, c_api) {
     nas_ndi_obj_id_table_delete(handle2);
 }
 
+TEST(ndi_obj_id_map_test, flat_table) {
+    nas::ndi_obj_id_table_t  t;
+
+    EXPECT_TRUE (t.empty ());
+    t[3] = 30;
+    t[1] = 10;
+    EXPECT_TRUE (t.size () == 2);
+    EXPECT_TRUE (t.begin()->first == 1);
+
+    // Spill from the inline entries to the heap
+    for (npu_id_t npu = 10; npu > 3; npu--) {
+        EXPECT_TRUE (t.insert ({npu, (ndi_obj_id_t) npu * 10}).second);
+    }
+    EXPECT_FALSE (t.insert ({5, 0}).second);
+    EXPECT_TRUE (t.size () == 9);
+    npu_id_t prev = -1;
+    for (auto& elem: t) {
+        EXPECT_TRUE (elem.first > prev);
+        EXPECT_TRUE (elem.second == (ndi_obj_id_t) elem.first * 10);
+        prev = elem.first;
+    }
+
+    ndi_obj_id_t  ndi_id = 0;
+    EXPECT_TRUE (t.get (7, ndi_id) && ndi_id == 70);
+    EXPECT_FALSE (t.get (2, ndi_id));
+    EXPECT_TRUE (t.count (2) == 0);
+    EXPECT_THROW (t.at (2), std::out_of_range);
+    EXPECT_TRUE (t.at (10) == 100);
+
+    nas::ndi_obj_id_table_t  copy (t);
+    EXPECT_TRUE (copy == t);
+    EXPECT_TRUE (t.erase (7) == 1);
+    EXPECT_TRUE (t.erase (7) == 0);
+    EXPECT_TRUE (copy != t);
+    EXPECT_TRUE (t.find (7) == t.end ());
+
+    nas::ndi_obj_id_table_t  moved (std::move (copy));
+    EXPECT_TRUE (copy.empty ());
+    EXPECT_TRUE (moved.size () == 9);
+
+    nas::ndi_obj_id_table_t  small;
+    small[2] = 20;
+    moved = small;
+    EXPECT_TRUE (moved == small);
+    small = std::move (t);
+    EXPECT_TRUE (small.size () == 8);
+
+    EXPECT_TRUE (sizeof (nas::ndi_obj_id_table_t) <= 48);
+}
+
+TEST(ndi_obj_id_map_test, compact) {
+    nas::ndi_obj_id_table_t  t1, t2;
+    cps_api_attr_id_t  attr_id_list[] = {5,6};
+
+    // Empty, inline and heap sized tables
+    for (npu_id_t npu = 0; npu < 5; npu++) {
+        auto cps_obj = cps_api_object_create ();
+        EXPECT_TRUE (nas::ndi_obj_id_table_cps_serialize_compact (t1, cps_obj, attr_id_list, 2));
+        t2[99] = 1;
+        EXPECT_TRUE (nas::ndi_obj_id_table_cps_unserialize (t2, cps_obj, attr_id_list, 2));
+        EXPECT_TRUE (t1 == t2);
+        cps_api_object_delete (cps_obj);
+        t1[npu] = 0x1000 + npu;
+    }
+
+    auto handle = nas_ndi_obj_id_table_create ();
+    nas_ndi_obj_id_table_set_id (handle, 3, 0x30);
+    auto cps_obj = cps_api_object_create ();
+    EXPECT_TRUE (nas_ndi_obj_id_table_cps_serialize_compact (handle, cps_obj, attr_id_list, 2));
+    EXPECT_TRUE (nas::ndi_obj_id_table_cps_unserialize (t2, cps_obj, attr_id_list, 2));
+    ndi_obj_id_t  ndi_id;
+    EXPECT_TRUE (t2.size () == 1 && t2.get (3, ndi_id) && ndi_id == 0x30);
+    cps_api_object_delete (cps_obj);
+    nas_ndi_obj_id_table_delete (handle);
+}
+
+TEST(ndi_obj_id_map_test, serialize_list) {
+    cps_api_attr_id_t  attr_id_list[] = {5,6};
+    std::vector<nas::ndi_obj_id_table_t> in (50);
+    std::vector<const nas::ndi_obj_id_table_t*> in_ptrs;
+    for (size_t i = 0; i < in.size (); i++) {
+        for (size_t npu = 0; npu < i % 4; npu++) {
+            in[i][npu] = i * 10 + npu;
+        }
+        in_ptrs.push_back (&in[i]);
+    }
+
+    for (int compact = 0; compact < 2; compact++) {
+        auto obj_list = cps_api_object_list_create ();
+        // First object pre-exists in the list
+        cps_api_object_list_append (obj_list, cps_api_object_create ());
+        EXPECT_TRUE (nas::ndi_obj_id_table_cps_serialize_list (in_ptrs.data (), in_ptrs.size (),
+                                                               obj_list, attr_id_list, 2, compact));
+        EXPECT_TRUE (cps_api_object_list_size (obj_list) == in.size ());
+
+        std::vector<nas::ndi_obj_id_table_t> out;
+        // Object without the opaque attribute
+        cps_api_object_list_append (obj_list, cps_api_object_create ());
+        // Empty tables add no attribute in the nested encoding
+        size_t expected = compact ? in.size () : in.size () - (in.size () + 3) / 4;
+        EXPECT_TRUE (nas::ndi_obj_id_table_cps_unserialize_list (out, obj_list, attr_id_list, 2)
+                     == expected);
+        EXPECT_TRUE (out.size () == in.size () + 1);
+        for (size_t i = 0; i < in.size (); i++) {
+            EXPECT_TRUE (out[i] == in[i]);
+        }
+        EXPECT_TRUE (out.back ().empty ());
+        cps_api_object_list_destroy (obj_list, true);
+    }
+}
+
+TEST(ndi_obj_id_map_test, serialize_benchmark) {
+    const size_t count = 100000;
+    nas::ndi_obj_id_table_t  table;
+    table[0] = 0x100000001;
+    table[1] = 0x100000002;
+    cps_api_attr_id_t  attr_id_list[] = {5};
+
+    for (int compact = 0; compact < 2; compact++) {
+        std::vector<cps_api_object_t> objs (count);
+        for (auto& obj: objs) obj = cps_api_object_create ();
+
+        auto start = std::chrono::steady_clock::now ();
+        for (auto obj: objs) {
+            if (compact) {
+                nas::ndi_obj_id_table_cps_serialize_compact (table, obj, attr_id_list, 1);
+            } else {
+                nas::ndi_obj_id_table_cps_serialize (table, obj, attr_id_list, 1);
+            }
+        }
+        auto mid = std::chrono::steady_clock::now ();
+        nas::ndi_obj_id_table_t  out;
+        for (auto obj: objs) {
+            EXPECT_TRUE (nas::ndi_obj_id_table_cps_unserialize (out, obj, attr_id_list, 1));
+        }
+        auto end = std::chrono::steady_clock::now ();
+        EXPECT_TRUE (out == table);
+
+        std::cout << (compact ? "compact" : "nested ") << " encoding: "
+                  << cps_api_object_to_array_len (objs[0]) << " bytes, serialize "
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count () / count
+                  << " ns, unserialize "
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count () / count
+                  << " ns per table" << std::endl;
+        for (auto obj: objs) cps_api_object_delete (obj);
+    }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2019 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtest/gtest.h"
+#include "nas_vrf_utils.h"
+#include "std_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void _vrf_op(nas_vrf_op_t op, const char *name, hal_vrf_id_t int_id, nas_obj_id_t obj_id)
+{
+    nas_vrf_ctrl_t vrf;
+    memset(&vrf, 0, sizeof(vrf));
+    safestrncpy(vrf.vrf_name, name, sizeof(vrf.vrf_name));
+    vrf.vrf_int_id = int_id;
+    vrf.vrf_id = obj_id;
+    ASSERT_TRUE(nas_update_vrf_info(op, &vrf) == STD_ERR_OK);
+}
+
+TEST(nas_vrf_utils, name_lookup)
+{
+    char name[NAS_VRF_NAME_SZ];
+    for (hal_vrf_id_t id = 1; id <= NAS_MAX_DATA_VRF_ID; ++id) {
+        snprintf(name, sizeof(name), "vrf%u", id);
+        _vrf_op(NAS_VRF_OP_ADD, name, id, 0x1000 + id);
+    }
+
+    for (hal_vrf_id_t id = 1; id <= NAS_MAX_DATA_VRF_ID; ++id) {
+        snprintf(name, sizeof(name), "vrf%u", id);
+        hal_vrf_id_t int_id = 0;
+        nas_obj_id_t obj_id = 0;
+        ASSERT_TRUE(nas_get_vrf_internal_id_from_vrf_name(name, &int_id) == STD_ERR_OK);
+        ASSERT_TRUE(nas_get_vrf_obj_id_from_vrf_name(name, &obj_id) == STD_ERR_OK);
+        ASSERT_TRUE(int_id == id);
+        ASSERT_TRUE(obj_id == 0x1000 + id);
+    }
+
+    nas_obj_id_t obj_id = 0;
+    ASSERT_FALSE(nas_get_vrf_obj_id_from_vrf_name("vrf0", &obj_id) == STD_ERR_OK);
+
+    /* Internal id assigned by a later update */
+    _vrf_op(NAS_VRF_OP_DEL, "vrf10", 0, 0);
+    ASSERT_FALSE(nas_get_vrf_obj_id_from_vrf_name("vrf10", &obj_id) == STD_ERR_OK);
+    _vrf_op(NAS_VRF_OP_ADD, "vrf10", 0, 0x2010);
+    _vrf_op(NAS_VRF_OP_UPD, "vrf10", 10, 0);
+    hal_vrf_id_t int_id = 0;
+    ASSERT_TRUE(nas_get_vrf_internal_id_from_vrf_name("vrf10", &int_id) == STD_ERR_OK);
+    ASSERT_TRUE(int_id == 10);
+
+    for (hal_vrf_id_t id = 1; id <= NAS_MAX_DATA_VRF_ID; ++id) {
+        snprintf(name, sizeof(name), "vrf%u", id);
+        _vrf_op(NAS_VRF_OP_DEL, name, 0, 0);
+    }
+    std::vector<nas_vrf_ctrl_t> all;
+    nas_get_all_vrf_ctrl(all);
+    ASSERT_TRUE(all.empty());
+}
+
+TEST(nas_vrf_utils, reverse_lookup)
+{
+    nas_vrf_ctrl_t vrf;
+    _vrf_op(NAS_VRF_OP_ADD, NAS_DEFAULT_VRF_NAME, NAS_DEFAULT_VRF_ID, 0x3000);
+    _vrf_op(NAS_VRF_OP_ADD, "blue", 0, 0x3001);
+
+    ASSERT_TRUE(nas_get_vrf_ctrl_from_vrf_id(NAS_DEFAULT_VRF_ID, &vrf) == STD_ERR_OK);
+    ASSERT_TRUE(strcmp(vrf.vrf_name, NAS_DEFAULT_VRF_NAME) == 0);
+    ASSERT_TRUE(nas_get_vrf_ctrl_from_obj_id(0x3001, &vrf) == STD_ERR_OK);
+    ASSERT_TRUE(strcmp(vrf.vrf_name, "blue") == 0);
+
+    /* Internal id not assigned yet */
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_vrf_id(5, &vrf) == STD_ERR_OK);
+    _vrf_op(NAS_VRF_OP_UPD, "blue", 5, 0);
+    ASSERT_TRUE(nas_get_vrf_ctrl_from_vrf_id(5, &vrf) == STD_ERR_OK);
+    ASSERT_TRUE(strcmp(vrf.vrf_name, "blue") == 0 && vrf.vrf_id == 0x3001);
+    _vrf_op(NAS_VRF_OP_UPD, "blue", 6, 0);
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_vrf_id(5, &vrf) == STD_ERR_OK);
+    ASSERT_TRUE(nas_get_vrf_ctrl_from_vrf_id(6, &vrf) == STD_ERR_OK);
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_vrf_id(NAS_MAX_VRF_ID + 1, &vrf) == STD_ERR_OK);
+
+    _vrf_op(NAS_VRF_OP_DEL, "blue", 0, 0);
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_vrf_id(6, &vrf) == STD_ERR_OK);
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_obj_id(0x3001, &vrf) == STD_ERR_OK);
+    _vrf_op(NAS_VRF_OP_DEL, NAS_DEFAULT_VRF_NAME, 0, 0);
+    ASSERT_FALSE(nas_get_vrf_ctrl_from_vrf_id(NAS_DEFAULT_VRF_ID, &vrf) == STD_ERR_OK);
+}
+
+static bool _count_vrf(const nas_vrf_ctrl_t *vrf_ctrl, void *context)
+{
+    ++*(size_t *)context;
+    return true;
+}
+
+TEST(nas_vrf_utils, walk)
+{
+    uint64_t gen = nas_get_vrf_table_gen();
+    _vrf_op(NAS_VRF_OP_ADD, "red", 11, 0x5011);
+    _vrf_op(NAS_VRF_OP_ADD, "green", 12, 0x5012);
+    ASSERT_TRUE(nas_get_vrf_table_gen() == gen + 2);
+
+    size_t count = 0;
+    uint64_t walked_gen = 0;
+    ASSERT_TRUE(nas_walk_vrf_ctrl(_count_vrf, &count, &walked_gen) == 2);
+    ASSERT_TRUE(count == 2);
+    ASSERT_TRUE(walked_gen == gen + 2);
+
+    /* Failed operations do not change the generation */
+    _vrf_op(NAS_VRF_OP_DEL, "blue", 0, 0);
+    _vrf_op(NAS_VRF_OP_ADD, "red", 11, 0x5011);
+    ASSERT_TRUE(nas_get_vrf_table_gen() == walked_gen);
+
+    _vrf_op(NAS_VRF_OP_UPD, "green", 13, 0);
+    ASSERT_TRUE(nas_get_vrf_table_gen() != walked_gen);
+
+    _vrf_op(NAS_VRF_OP_DEL, "red", 0, 0);
+    _vrf_op(NAS_VRF_OP_DEL, "green", 0, 0);
+    count = 0;
+    ASSERT_TRUE(nas_walk_vrf_ctrl(_count_vrf, &count, nullptr) == 0);
+}
+
+TEST(nas_vrf_utils, concurrent_update)
+{
+    _vrf_op(NAS_VRF_OP_ADD, "stable", 7, 0x4007);
+    std::atomic<bool> done{false};
+    std::atomic<size_t> misses{0};
+    std::vector<std::thread> readers;
+    for (int ix = 0; ix < 4; ++ix) {
+        readers.emplace_back([&]() {
+            nas_vrf_ctrl_t vrf;
+            while (!done) {
+                if (nas_get_vrf_ctrl_from_vrf_name("stable", &vrf) != STD_ERR_OK ||
+                    nas_get_vrf_ctrl_from_vrf_id(7, &vrf) != STD_ERR_OK ||
+                    vrf.vrf_id != 0x4007) {
+                    ++misses;
+                }
+            }
+        });
+    }
+    for (int ix = 0; ix < 2000; ++ix) {
+        _vrf_op(NAS_VRF_OP_ADD, "churn", 8, 0x4008);
+        _vrf_op(NAS_VRF_OP_DEL, "churn", 0, 0);
+    }
+    done = true;
+    for (auto &t : readers) t.join();
+    ASSERT_TRUE(misses == 0);
+    _vrf_op(NAS_VRF_OP_DEL, "stable", 0, 0);
+}
+
+TEST(nas_vrf_utils, lookup_benchmark)
+{
+    /* Names are built up front so the workers time only the lookup */
+    std::vector<std::string> names(NAS_MAX_DATA_VRF_ID + 1);
+    for (hal_vrf_id_t id = 1; id <= NAS_MAX_DATA_VRF_ID; ++id) {
+        names[id] = "vrf" + std::to_string(id);
+        _vrf_op(NAS_VRF_OP_ADD, names[id].c_str(), id, 0x1000 + id);
+    }
+
+    for (size_t threads = 1; threads <= 32; threads *= 2) {
+        std::atomic<bool> done{false};
+        std::atomic<size_t> total{0};
+        std::vector<std::thread> workers;
+        for (size_t ix = 0; ix < threads; ++ix) {
+            workers.emplace_back([&, ix]() {
+                nas_obj_id_t obj_id;
+                size_t count = 0;
+                hal_vrf_id_t id = 1 + ix;
+                while (!done.load(std::memory_order_relaxed)) {
+                    nas_get_vrf_obj_id_from_vrf_name(names[id].c_str(), &obj_id);
+                    id = (id % NAS_MAX_DATA_VRF_ID) + 1;
+                    ++count;
+                }
+                total += count;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        done = true;
+        for (auto &t : workers) t.join();
+        printf("%2zu threads: %12.0f lookups/sec\n", threads, total / 0.2);
+    }
+
+    for (hal_vrf_id_t id = 1; id <= NAS_MAX_DATA_VRF_ID; ++id) {
+        _vrf_op(NAS_VRF_OP_DEL, names[id].c_str(), 0, 0);
+    }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}